@@ -0,0 +1,273 @@
+#ifndef BUFFER_ARENA_H
+#define BUFFER_ARENA_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/packed_vertex.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+
+// the attribute layout of PackedVertex, set up on the currently bound VAO and GL_ARRAY_BUFFER
+inline void SetupPackedVertexAttributes()
+{
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)0);
+    // vertex normals, normalized 10:10:10:2
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+    // vertex texture coords, half floats
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
+    // vertex tangent with the bitangent's handedness in w, normalized 10:10:10:2
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Tangent));
+}
+
+// First-fit allocator over an abstract range [0, capacity). Free ranges are kept sorted by offset and
+// merged with their neighbours when freed, so the space does not fragment into slivers.
+class FreeListAllocator
+{
+public:
+    static const size_t Invalid = SIZE_MAX;
+
+    explicit FreeListAllocator(size_t capacity = 0) : capacity(0), used(0) { Grow(capacity); }
+
+    // returns the offset of size units aligned to alignment, or Invalid when no free range is big enough
+    size_t Allocate(size_t size, size_t alignment = 1)
+    {
+        if (size == 0)
+            return 0;
+        for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it)
+        {
+            size_t offset = (it->first + alignment - 1) / alignment * alignment;
+            size_t padding = offset - it->first;
+            if (it->second < padding + size)
+                continue;
+            size_t rangeStart = it->first, rangeSize = it->second;
+            freeRanges.erase(it);
+            // give back what is left in front of and behind the allocation
+            if (padding > 0)
+                freeRanges[rangeStart] = padding;
+            if (rangeSize > padding + size)
+                freeRanges[offset + size] = rangeSize - padding - size;
+            used += size;
+            return offset;
+        }
+        return Invalid;
+    }
+
+    void Free(size_t offset, size_t size)
+    {
+        if (size == 0)
+            return;
+        used -= size;
+        auto next = freeRanges.lower_bound(offset);
+        if (next != freeRanges.begin())
+        {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset)
+            {
+                offset = previous->first;
+                size += previous->second;
+                freeRanges.erase(previous);
+            }
+        }
+        if (next != freeRanges.end() && offset + size == next->first)
+        {
+            size += next->second;
+            freeRanges.erase(next);
+        }
+        freeRanges[offset] = size;
+    }
+
+    // appends [capacity, newCapacity) to the free space
+    void Grow(size_t newCapacity)
+    {
+        if (newCapacity <= capacity)
+            return;
+        size_t oldCapacity = capacity;
+        capacity = newCapacity;
+        used += newCapacity - oldCapacity;   // Free() subtracts it again
+        Free(oldCapacity, newCapacity - oldCapacity);
+    }
+
+    size_t Capacity() const { return capacity; }
+    size_t Used() const { return used; }
+    size_t FreeRangeCount() const { return freeRanges.size(); }
+
+private:
+    std::map<size_t, size_t> freeRanges;    // offset -> size
+    size_t capacity;
+    size_t used;
+};
+
+// One large vertex buffer and one large index buffer with a single VAO, from which meshes suballocate
+// their geometry. Meshes drawn from the same arena only need the one VAO bind and draw with
+// glDrawElementsBaseVertex, instead of owning (and binding) a VAO, VBO and EBO each.
+// There is one vertex format (PackedVertex), so one VAO per arena. Both buffers grow on demand; growing
+// copies the old contents on the GPU, so existing allocations keep their offsets.
+class BufferArena
+{
+public:
+    // index ranges are aligned so both 16 and 32 bit indices can start anywhere in the buffer
+    static const size_t IndexAlignment = 4;
+
+    struct Range {
+        size_t firstVertex = 0;     // base vertex of the mesh in the vertex buffer
+        size_t vertexCount = 0;
+        size_t indexOffset = 0;     // byte offset of the mesh's indices in the index buffer
+        size_t indexBytes = 0;
+    };
+
+    BufferArena(size_t vertexCapacity, size_t indexCapacityBytes)
+        : vertices(vertexCapacity), indexBytes(roundUp(indexCapacityBytes))
+    {
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.Capacity() * sizeof(PackedVertex), nullptr, GL_STATIC_DRAW);
+        SetupPackedVertexAttributes();
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes.Capacity(), nullptr, GL_STATIC_DRAW);
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    BufferArena(const BufferArena&) = delete;
+    BufferArena& operator=(const BufferArena&) = delete;
+    ~BufferArena()
+    {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ebo);
+    }
+
+    // arena shared by every Model that asks for it. Never freed: a static destructor would run after the
+    // GL context is gone.
+    static BufferArena &Shared()
+    {
+        static BufferArena *arena = new BufferArena(1 << 16, 1 << 18);
+        return *arena;
+    }
+
+    unsigned int VAO() const { return vao; }
+
+    Range Allocate(size_t vertexCount, size_t indexBytesNeeded)
+    {
+        Range range;
+        range.vertexCount = vertexCount;
+        range.indexBytes = roundUp(indexBytesNeeded);
+        range.firstVertex = vertices.Allocate(vertexCount);
+        if (range.firstVertex == FreeListAllocator::Invalid)
+        {
+            growVertices(vertexCount);
+            range.firstVertex = vertices.Allocate(vertexCount);
+        }
+        range.indexOffset = indexBytes.Allocate(range.indexBytes, IndexAlignment);
+        if (range.indexOffset == FreeListAllocator::Invalid)
+        {
+            growIndices(range.indexBytes);
+            range.indexOffset = indexBytes.Allocate(range.indexBytes, IndexAlignment);
+        }
+        return range;
+    }
+
+    void Free(const Range &range)
+    {
+        vertices.Free(range.firstVertex, range.vertexCount);
+        indexBytes.Free(range.indexOffset, range.indexBytes);
+    }
+
+    // uploads go through the copy-write target so they need neither a VAO nor the element buffer binding
+    void UploadVertices(size_t firstVertex, const PackedVertex *data, size_t count)
+    {
+        upload(vbo, firstVertex * sizeof(PackedVertex), count * sizeof(PackedVertex), data);
+    }
+
+    void UploadIndices(size_t byteOffset, const void *data, size_t bytes)
+    {
+        upload(ebo, byteOffset, bytes, data);
+    }
+
+    std::string Report() const
+    {
+        return std::to_string(vertices.Used() * sizeof(PackedVertex) / 1024) + "/"
+             + std::to_string(vertices.Capacity() * sizeof(PackedVertex) / 1024) + " KiB of vertices, "
+             + std::to_string(indexBytes.Used() / 1024) + "/" + std::to_string(indexBytes.Capacity() / 1024)
+             + " KiB of indices, " + std::to_string(vertices.FreeRangeCount() + indexBytes.FreeRangeCount())
+             + " free ranges";
+    }
+
+private:
+    unsigned int vao = 0, vbo = 0, ebo = 0;
+    FreeListAllocator vertices;     // in vertices
+    FreeListAllocator indexBytes;   // in bytes
+
+    static size_t roundUp(size_t bytes)
+    {
+        return (bytes + IndexAlignment - 1) / IndexAlignment * IndexAlignment;
+    }
+
+    static void upload(unsigned int buffer, size_t offset, size_t bytes, const void *data)
+    {
+        if (bytes == 0)
+            return;
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, bytes, data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    // replaces buffer with one of newBytes holding a copy of its first oldBytes
+    static void reallocate(unsigned int &buffer, size_t oldBytes, size_t newBytes)
+    {
+        unsigned int grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        if (oldBytes > 0)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        buffer = grown;
+    }
+
+    void growVertices(size_t needed)
+    {
+        size_t oldCapacity = vertices.Capacity();
+        size_t newCapacity = std::max(oldCapacity * 2, oldCapacity + needed);
+        reallocate(vbo, oldCapacity * sizeof(PackedVertex), newCapacity * sizeof(PackedVertex));
+        vertices.Grow(newCapacity);
+        // the attribute pointers captured the old buffer
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        SetupPackedVertexAttributes();
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        std::cout << "BufferArena: grew vertex buffer to " << newCapacity * sizeof(PackedVertex) / 1024 << " KiB" << std::endl;
+    }
+
+    void growIndices(size_t needed)
+    {
+        size_t oldCapacity = indexBytes.Capacity();
+        // leave room for the alignment padding in front of the new allocation
+        size_t newCapacity = std::max(oldCapacity * 2, oldCapacity + needed + IndexAlignment);
+        reallocate(ebo, oldCapacity, newCapacity);
+        indexBytes.Grow(newCapacity);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBindVertexArray(0);
+        std::cout << "BufferArena: grew index buffer to " << newCapacity / 1024 << " KiB" << std::endl;
+    }
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <unordered_set>
+
+// Extensions beyond the GL 3.3 core profile glad was generated for. Load() queries the driver once on the
+// GL thread (after gladLoadGLLoader); afterwards the flags may be read from any thread.
+class GLExtensions
+{
+public:
+    bool loaded = false;
+    bool textureCompressionS3TC = false;
+    bool textureSRGB = false;
+
+    static GLExtensions &Get()
+    {
+        static GLExtensions extensions;
+        return extensions;
+    }
+
+    void Load()
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            names.insert(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)));
+        textureCompressionS3TC = Has("GL_EXT_texture_compression_s3tc");
+        textureSRGB = Has("GL_EXT_texture_sRGB");
+        loaded = true;
+    }
+
+    bool Has(const std::string &name) const
+    {
+        return names.count(name) > 0;
+    }
+
+private:
+    std::unordered_set<std::string> names;
+};
+
+#endif
@@ -6,8 +6,14 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/buffer_arena.h>
+#include <learnopengl/meshlet.h>
+#include <learnopengl/packed_vertex.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture.h>
+#include <learnopengl/texture_feedback.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 using namespace std;
@@ -25,6 +31,31 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
+// packs a vertex into the 24 byte layout the GPU gets (see packed_vertex.h)
+inline PackedVertex PackVertex(const Vertex &vertex)
+{
+    PackedVertex packed;
+    packed.Position[0] = vertex.Position.x;
+    packed.Position[1] = vertex.Position.y;
+    packed.Position[2] = vertex.Position.z;
+    glm::vec3 normal = NormalizeOrZero(vertex.Normal);
+    packed.Normal = PackSnorm1010102(normal, 0.0f);
+    // handedness: does the imported bitangent agree with the one the shader rebuilds?
+    float handedness = glm::dot(glm::cross(normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+    packed.Tangent = PackSnorm1010102(NormalizeOrZero(vertex.Tangent), handedness);
+    packed.TexCoords[0] = FloatToHalf(vertex.TexCoords.x);
+    packed.TexCoords[1] = FloatToHalf(vertex.TexCoords.y);
+    return packed;
+}
+
+inline vector<PackedVertex> PackVertices(const vector<Vertex> &vertices)
+{
+    vector<PackedVertex> packed(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+        packed[i] = PackVertex(vertices[i]);
+    return packed;
+}
+
 
 
 struct Texture {
@@ -33,37 +64,306 @@ struct Texture {
     string path;
 };
 
+// one level of detail: a run of the mesh's indices into the shared vertex array
+struct MeshLod {
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float    error;         // how far the level deviates from the full mesh, in object space units
+};
+
+// CPU-side geometry of one mesh before it goes to the GPU. The arrays are either owned (fresh import) or
+// live in memory owned by someone else, e.g. a memory-mapped mesh cache.
+// A fresh import fills the full precision vertices, which Pack() turns into the GPU layout once all
+// processing is done; only packed vertices are uploaded and cached.
+// With levels of detail the index arrays of all levels follow each other in indices, finest first.
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<PackedVertex> packedVertices;
+    vector<unsigned int> indices;
+    vector<Texture>      textures;
+    vector<MeshLod>      lods;      // empty: a single level made of all indices
+    vector<Meshlet>      meshlets;  // clusters of the full detail level, empty for small meshes
+
+    const PackedVertex *mappedVertices = nullptr;
+    const unsigned int *mappedIndices = nullptr;
+    size_t mappedVertexCount = 0;
+    size_t mappedIndexCount = 0;
+
+    void Pack()
+    {
+        packedVertices = PackVertices(vertices);
+        vector<Vertex>().swap(vertices);
+    }
+
+    const PackedVertex *VertexData() const { return mappedVertices ? mappedVertices : packedVertices.data(); }
+    size_t VertexCount() const { return mappedVertices ? mappedVertexCount : packedVertices.size(); }
+    const unsigned int *IndexData() const { return mappedIndices ? mappedIndices : indices.data(); }
+    size_t IndexCount() const { return mappedIndices ? mappedIndexCount : indices.size(); }
+
+    vector<MeshLod> Lods() const
+    {
+        if (!lods.empty())
+            return lods;
+        return vector<MeshLod>(1, MeshLod{0, (uint32_t)IndexCount(), 0.0f});
+    }
+};
+
+// where a Mesh keeps its geometry after loading
+enum MeshResidency {
+    MESH_GPU_ONLY,      // the CPU arrays are freed as soon as they are uploaded
+    MESH_CPU_AND_GPU,   // the arrays stay in memory as well, e.g. for picking or physics
+    MESH_CPU_ONLY       // never uploaded; Draw() does nothing
+};
+
+// Owns its GL buffers, or its range of a BufferArena, so it can be moved but not copied.
 class Mesh {
 public:
-    // mesh Data
-    vector<Vertex>       vertices;
+    // mesh Data, empty unless the residency keeps a CPU copy
+    vector<PackedVertex> vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    vector<MeshLod>      lods;          // at least one; indexCount covers all of them
+    vector<Meshlet>      meshlets;      // kept whatever the residency, they are needed for culling
 
-    unsigned int VAO;
+    unsigned int VAO = 0;               // 0 for meshes that live in a BufferArena
+    BufferArena *arena = nullptr;
+    BufferArena::Range arenaRange;
+    unsigned int indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;  // GL_UNSIGNED_SHORT whenever all vertices can be addressed with 16 bits
+    MeshResidency residency = MESH_GPU_ONLY;
     std::string glslIdentifierPrefix;
     // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Mesh(const vector<Vertex> &vertices, vector<unsigned int> indices, vector<Texture> textures,
+         MeshResidency residency = MESH_GPU_ONLY)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        MeshData data;
+        data.packedVertices = PackVertices(vertices);
+        data.indices = std::move(indices);
+        data.textures = std::move(textures);
+        adopt(std::move(data), residency);
+    }
 
-        // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+    // constructor for imported data. Mapped arrays (a mesh cache) are uploaded straight from the mapping and
+    // only copied if the residency keeps a CPU copy; owned arrays are moved into the mesh in that case.
+    // With an arena the geometry is suballocated from it instead of getting buffers of its own.
+    Mesh(MeshData &&data, MeshResidency residency = MESH_GPU_ONLY, BufferArena *arena = nullptr)
+        : arena(arena)
+    {
+        adopt(std::move(data), residency);
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // constructor for meshes that are streamed in over several frames: only allocates the GPU buffers,
+    // the contents follow through UploadVertices()/UploadIndices().
+    Mesh(size_t vertexCount, size_t indexCount, vector<Texture> textures, BufferArena *arena = nullptr)
+        : arena(arena)
+    {
+        this->textures = std::move(textures);
+        lods.assign(1, MeshLod{0, (uint32_t)indexCount, 0.0f});
+        setupMesh(nullptr, vertexCount, nullptr, indexCount);
+    }
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh &&other) noexcept { *this = std::move(other); }
+    Mesh& operator=(Mesh &&other) noexcept
+    {
+        std::swap(vertices, other.vertices);
+        std::swap(indices, other.indices);
+        std::swap(textures, other.textures);
+        std::swap(lods, other.lods);
+        std::swap(meshlets, other.meshlets);
+        std::swap(VAO, other.VAO);
+        std::swap(arena, other.arena);
+        std::swap(arenaRange, other.arenaRange);
+        std::swap(VBO, other.VBO);
+        std::swap(EBO, other.EBO);
+        std::swap(indexCount, other.indexCount);
+        std::swap(indexType, other.indexType);
+        std::swap(residency, other.residency);
+        std::swap(glslIdentifierPrefix, other.glslIdentifierPrefix);
+        std::swap(samplerNames, other.samplerNames);
+        std::swap(samplerPrefix, other.samplerPrefix);
+        std::swap(groupTextureIds, other.groupTextureIds);
+        std::swap(groupId, other.groupId);
+        return *this;
+    }
+    ~Mesh()
+    {
+        if (VAO)
+            glDeleteVertexArrays(1, &VAO);
+        if (VBO)
+            glDeleteBuffers(1, &VBO);
+        if (EBO)
+            glDeleteBuffers(1, &EBO);
+        if (arena)
+            arena->Free(arenaRange);
+    }
+
+    bool IsOnGPU() const { return VAO || arena; }
+
+    // keeps the arrays of data as this mesh's CPU copy, for a streamed mesh that wants one
+    void KeepCPUCopy(MeshData &&data)
+    {
+        residency = IsOnGPU() ? MESH_CPU_AND_GPU : MESH_CPU_ONLY;
+        if (data.mappedVertices)
+            vertices.assign(data.mappedVertices, data.mappedVertices + data.mappedVertexCount);
+        else
+            vertices = std::move(data.packedVertices);
+        if (data.mappedIndices)
+            indices.assign(data.mappedIndices, data.mappedIndices + data.mappedIndexCount);
+        else
+            indices = std::move(data.indices);
+    }
+
+    // bytes of vertices and indices held in CPU memory
+    size_t CPUBytes() const
+    {
+        return vertices.capacity() * sizeof(PackedVertex) + indices.capacity() * sizeof(unsigned int);
+    }
+
+    void UploadVertices(size_t first, const PackedVertex *data, size_t count)
+    {
+        if (arena)
+        {
+            arena->UploadVertices(arenaRange.firstVertex + first, data, count);
+            return;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(PackedVertex), count * sizeof(PackedVertex), data);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void UploadIndices(size_t first, const unsigned int *data, size_t count)
+    {
+        vector<unsigned short> shortIndices;
+        const void *indexData = narrowIndices(data, count, shortIndices);
+        if (arena)
+        {
+            arena->UploadIndices(arenaRange.indexOffset + first * IndexSize(), indexData, count * IndexSize());
+            return;
+        }
+        // the element buffer binding is VAO state, so go through the VAO
+        glBindVertexArray(VAO);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, first * IndexSize(), count * IndexSize(), indexData);
+        glBindVertexArray(0);
+    }
+
+    // the narrowest index type that can address vertexCount vertices
+    static GLenum IndexTypeFor(size_t vertexCount)
+    {
+        return vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
+    size_t IndexSize() const
+    {
+        return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+    }
+
+    // render the mesh, at the given level of detail (clamped to the levels it has). With a cull view (in
+    // the mesh's object space) the full detail level only draws the meshlets that can be visible.
+    void Draw(Shader &shader, unsigned int lod = 0, const CullView *cull = nullptr)
+    {
+        if (!IsOnGPU() || !collectRanges(lod, cull))
+            return;
+        bindTextures(shader);
+        // draw mesh
+        glBindVertexArray(arena ? arena->VAO() : VAO);
+        drawRanges();
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // draws a mesh of an arena whose VAO the caller has already bound, so a whole model costs one VAO bind
+    void DrawInBoundArena(Shader &shader, unsigned int lod = 0, const CullView *cull = nullptr)
+    {
+        if (!collectRanges(lod, cull))
+            return;
+        bindTextures(shader);
+        drawRanges();
+    }
+
+private:
+    // render data
+    unsigned int VBO = 0, EBO = 0;
+    // index runs of the current draw, reused between draws to avoid allocating every frame
+    vector<GLsizei> rangeCounts;
+    vector<const void*> rangeOffsets;
+    vector<GLint> rangeBaseVertices;
+    // sampler uniform of each texture and the prefix they were made with
+    vector<UniformName> samplerNames;
+    std::string samplerPrefix;
+    // the texture ids the feedback group was looked up for, and that group
+    vector<unsigned int> groupTextureIds;
+    unsigned int groupId = 0;
+
+    // fills the index runs to draw; false if there are none
+    bool collectRanges(unsigned int lod, const CullView *cull)
+    {
+        rangeCounts.clear();
+        rangeOffsets.clear();
+        size_t level = std::min<size_t>(lod, lods.size() - 1);
+        if (!cull || level != 0 || meshlets.empty())
+        {
+            addRange(lods[level].indexOffset, lods[level].indexCount);
+        }
+        else
+        {
+            CullStats &stats = CullStats::Get();
+            for (const Meshlet &meshlet : meshlets)
+            {
+                Meshlets::Visibility visibility = Meshlets::Cull(meshlet, *cull);
+                stats.meshletsTested++;
+                stats.trianglesTested += meshlet.indexCount / 3;
+                if (visibility == Meshlets::VISIBLE)
+                {
+                    addRange(meshlet.indexOffset, meshlet.indexCount);
+                    continue;
+                }
+                stats.meshletsCulled++;
+                if (visibility == Meshlets::OUTSIDE_FRUSTUM)
+                    stats.trianglesFrustumCulled += meshlet.indexCount / 3;
+                else
+                    stats.trianglesBackfaceCulled += meshlet.indexCount / 3;
+            }
+        }
+        rangeBaseVertices.assign(rangeCounts.size(), arena ? (GLint)arenaRange.firstVertex : 0);
+        return !rangeCounts.empty();
+    }
+
+    // appends a run of indices, merging it into the previous one when they touch
+    void addRange(size_t first, size_t count)
+    {
+        size_t offset = (arena ? arenaRange.indexOffset : 0) + first * IndexSize();
+        if (!rangeCounts.empty() && (size_t)rangeOffsets.back() + rangeCounts.back() * IndexSize() == offset)
+        {
+            rangeCounts.back() += count;
+            return;
+        }
+        rangeCounts.push_back(count);
+        rangeOffsets.push_back((const void*)offset);
+    }
+
+    void drawRanges()
+    {
+        if (rangeCounts.size() == 1)
+            glDrawElementsBaseVertex(GL_TRIANGLES, rangeCounts[0], indexType, rangeOffsets[0], rangeBaseVertices[0]);
+        else
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, rangeCounts.data(), indexType, rangeOffsets.data(),
+                                          rangeCounts.size(), rangeBaseVertices.data());
+    }
+
+    // the sampler uniform of each texture: diffuse_textureN and so on, behind glslIdentifierPrefix
+    void nameSamplers()
     {
-        // bind appropriate textures
         unsigned int diffuseNr  = 1;
         unsigned int specularNr = 1;
         unsigned int normalNr   = 1;
         unsigned int heightNr   = 1;
+        samplerNames.clear();
         for(unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
             string number;
             string name = textures[i].type;
@@ -76,31 +376,91 @@ public:
                 number = std::to_string(normalNr++); // transfer unsigned int to stream
             else if(name == "texture_height")
                 number = std::to_string(heightNr++); // transfer unsigned int to stream
+            samplerNames.push_back(UniformName(glslIdentifierPrefix + name + number));
+        }
+        samplerPrefix = glslIdentifierPrefix;
+    }
 
+    // the texture feedback group of the mesh's textures; looked up again only when their ids changed
+    // (the model patches them once the images are uploaded), so drawing builds no id list
+    unsigned int textureGroup()
+    {
+        bool current = groupTextureIds.size() == textures.size();
+        for (size_t i = 0; current && i < textures.size(); i++)
+            current = groupTextureIds[i] == textures[i].id;
+        if (!current)
+        {
+            groupTextureIds.clear();
+            for (const Texture &texture : textures)
+                groupTextureIds.push_back(texture.id);
+            groupId = TextureFeedback::Group(groupTextureIds);
+        }
+        return groupId;
+    }
+
+    void bindTextures(Shader &shader)
+    {
+        // the names only change with the prefix, so they are built once rather than every draw
+        if (samplerNames.size() != textures.size() || samplerPrefix != glslIdentifierPrefix)
+            nameSamplers();
+        // bind appropriate textures
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
+            glUniform1i(shader.Location(samplerNames[i]), i);
             // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            BindTexture(GL_TEXTURE_2D, textures[i].id);
         }
+        // the texture feedback pass records which textures the mesh samples
+        GLint feedbackGroup = shader.Location("feedbackGroup");
+        if (feedbackGroup >= 0)
+            glUniform1ui(feedbackGroup, textureGroup());
+    }
 
-
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+    void adopt(MeshData &&data, MeshResidency residency)
+    {
+        this->textures = std::move(data.textures);
+        lods = data.Lods();
+        meshlets = std::move(data.meshlets);
+        indexCount = data.IndexCount();
+        // now that we have all the required data, set the vertex buffers and its attribute pointers.
+        if (residency == MESH_CPU_ONLY)
+            arena = nullptr;
+        else
+            setupMesh(data.VertexData(), data.VertexCount(), data.IndexData(), data.IndexCount());
+        if (residency != MESH_GPU_ONLY)
+            KeepCPUCopy(std::move(data));
+        this->residency = residency;
     }
 
-private:
-    // render data
-    unsigned int VBO, EBO;
+    // indices are kept as 32 bit on the CPU; returns them in the mesh's index type, converting into storage if needed
+    const void *narrowIndices(const unsigned int *indices, size_t count, vector<unsigned short> &storage) const
+    {
+        if (indexType != GL_UNSIGNED_SHORT)
+            return indices;
+        storage.assign(indices, indices + count);
+        return storage.data();
+    }
 
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const PackedVertex *vertexData, size_t vertexCount, const unsigned int *indexData, size_t indexCount)
     {
+        this->indexCount = indexCount;
+        indexType = IndexTypeFor(vertexCount);
+        vector<unsigned short> shortIndices;
+        const void *gpuIndices = indexData ? narrowIndices(indexData, indexCount, shortIndices) : nullptr;
+
+        if (arena)
+        {
+            arenaRange = arena->Allocate(vertexCount, indexCount * IndexSize());
+            if (vertexData)
+                arena->UploadVertices(arenaRange.firstVertex, vertexData, vertexCount);
+            if (gpuIndices)
+                arena->UploadIndices(arenaRange.indexOffset, gpuIndices, indexCount * IndexSize());
+            return;
+        }
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -110,29 +470,15 @@ private:
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
         // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to the
+        // packed attribute layout described in packed_vertex.h, which translates to a byte array.
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(PackedVertex), vertexData, GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * IndexSize(), gpuIndices, GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        SetupPackedVertexAttributes();
 
         glBindVertexArray(0);
     }
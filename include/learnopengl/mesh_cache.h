@@ -0,0 +1,497 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary cache of a Model's processed meshes, written next to the source asset as "<asset>.meshcache".
+// The file is memory-mapped on later runs so the vertex and index arrays can be handed to the GPU without
+// going through Assimp again. Layout (all offsets are from the start of the file, every table starts on an
+// 8 byte boundary so the 64 bit fields of its records are aligned whatever the counts before it):
+//
+//   MeshCacheHeader
+//   MeshCacheMeshRecord   [meshCount]
+//   MeshCacheTextureRecord[total texture count]
+//   MeshLod               [total level of detail count]
+//   Meshlet               [total meshlet count]
+//   MeshCacheDependencyRecord[dependencyCount]
+//   string blob (texture types and paths, dependency paths)
+//   vertex (PackedVertex) and index arrays, 4 byte aligned
+//
+// The cache is rejected when the format version, importer tag, import flags or MeshProcessing flags differ,
+// or when the source file or one of the files it depends on (the MTL files of an OBJ) changed.
+// A changed mtime alone (e.g. after a fresh checkout) is not enough to reject it: the content hash decides.
+struct MeshCacheHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t importer;
+    uint32_t importFlags;
+    uint32_t processFlags;
+    uint32_t meshCount;
+    uint32_t dependencyCount;
+    uint32_t blobSize;
+    int64_t  sourceMtime;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+};
+
+struct MeshCacheMeshRecord {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    uint32_t firstLod;
+    uint32_t lodCount;
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+};
+
+struct MeshCacheTextureRecord {
+    uint32_t typeOffset;
+    uint32_t typeLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+// a file the import read besides the source; a missing file is recorded with mtime -1
+struct MeshCacheDependencyRecord {
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    int64_t  mtime;
+    uint64_t size;
+    uint64_t hash;
+};
+
+class MeshCache
+{
+public:
+    static const uint32_t Version = 9;
+
+    MeshCache() : data(nullptr), size(0), tables() {}
+    ~MeshCache() { Close(); }
+    MeshCache(const MeshCache&) = delete;
+    MeshCache& operator=(const MeshCache&) = delete;
+
+    static std::string CachePath(const std::string &sourcePath)
+    {
+        return sourcePath + ".meshcache";
+    }
+
+    // maps the cache belonging to sourcePath; returns false if there is none or it is stale. importer tags
+    // whatever produces the meshes (and its version), it is compared as is.
+    bool Open(const std::string &sourcePath, uint32_t importer, uint32_t importFlags, uint32_t processFlags)
+    {
+        Close();
+        SourceInfo source;
+        if (!statSource(sourcePath, source))
+            return false;
+
+        int fd = open(CachePath(sourcePath).c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(MeshCacheHeader))
+        {
+            close(fd);
+            return false;
+        }
+        void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        data = static_cast<const char*>(mapped);
+        size = st.st_size;
+
+        const MeshCacheHeader &h = header();
+        bool valid = std::memcmp(h.magic, "MSHC", 4) == 0 && h.version == Version && h.importer == importer
+                && h.importFlags == importFlags && h.processFlags == processFlags
+                && h.sourceSize == source.size;
+        if (valid)
+            valid = locateTables() && recordsInBounds();
+        if (valid)
+            valid = dependenciesUnchanged();
+        if (valid && h.sourceMtime != source.mtime)
+            valid = h.sourceHash == hashFile(sourcePath);
+        if (!valid)
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void Close()
+    {
+        if (data)
+            munmap(const_cast<char*>(data), size);
+        data = nullptr;
+        size = 0;
+    }
+
+    unsigned int MeshCount() const { return header().meshCount; }
+
+    // describes the i-th mesh with its arrays pointing into the mapping; valid while the cache stays open
+    MeshData GetMeshData(unsigned int i) const
+    {
+        const MeshCacheMeshRecord &mesh = meshRecord(i);
+        MeshData meshData;
+        meshData.mappedVertices = reinterpret_cast<const PackedVertex*>(data + mesh.vertexOffset);
+        meshData.mappedVertexCount = mesh.vertexCount;
+        meshData.mappedIndices = reinterpret_cast<const unsigned int*>(data + mesh.indexOffset);
+        meshData.mappedIndexCount = mesh.indexCount;
+        for (unsigned int j = 0; j < mesh.textureCount; j++)
+        {
+            // texture type ("texture_diffuse", ...) and path, id is assigned once the texture is loaded
+            const MeshCacheTextureRecord &t = textureRecords()[mesh.firstTexture + j];
+            Texture texture;
+            texture.id = 0;
+            texture.type.assign(stringBlob() + t.typeOffset, t.typeLength);
+            texture.path.assign(stringBlob() + t.pathOffset, t.pathLength);
+            meshData.textures.push_back(texture);
+        }
+        meshData.lods.assign(lodRecords() + mesh.firstLod, lodRecords() + mesh.firstLod + mesh.lodCount);
+        meshData.meshlets.assign(meshletRecords() + mesh.firstMeshlet, meshletRecords() + mesh.firstMeshlet + mesh.meshletCount);
+        return meshData;
+    }
+
+    // writes the meshes of a freshly imported model; dependencies are the other files the import read.
+    // Failures only cost us the next warm start.
+    static bool Write(const std::string &sourcePath, uint32_t importer, uint32_t importFlags, uint32_t processFlags,
+                      const std::vector<std::string> &dependencies, const vector<MeshData> &meshes)
+    {
+        SourceInfo source;
+        if (!statSource(sourcePath, source))
+            return false;
+
+        MeshCacheHeader h;
+        std::memcpy(h.magic, "MSHC", 4);
+        h.version = Version;
+        h.importer = importer;
+        h.importFlags = importFlags;
+        h.processFlags = processFlags;
+        h.meshCount = meshes.size();
+        h.dependencyCount = dependencies.size();
+        h.sourceMtime = source.mtime;
+        h.sourceSize = source.size;
+        h.sourceHash = hashFile(sourcePath);
+
+        std::vector<MeshCacheMeshRecord> records(meshes.size());
+        std::vector<MeshCacheTextureRecord> textures;
+        std::vector<MeshLod> lods;
+        std::vector<Meshlet> meshlets;
+        std::string blob;
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            records[i].vertexCount = meshes[i].VertexCount();
+            records[i].indexCount = meshes[i].IndexCount();
+            records[i].firstTexture = textures.size();
+            records[i].textureCount = meshes[i].textures.size();
+            records[i].firstLod = lods.size();
+            records[i].lodCount = meshes[i].lods.size();
+            lods.insert(lods.end(), meshes[i].lods.begin(), meshes[i].lods.end());
+            records[i].firstMeshlet = meshlets.size();
+            records[i].meshletCount = meshes[i].meshlets.size();
+            meshlets.insert(meshlets.end(), meshes[i].meshlets.begin(), meshes[i].meshlets.end());
+            for (const Texture &texture : meshes[i].textures)
+            {
+                MeshCacheTextureRecord t;
+                t.typeOffset = blob.size();
+                t.typeLength = texture.type.size();
+                blob += texture.type;
+                t.pathOffset = blob.size();
+                t.pathLength = texture.path.size();
+                blob += texture.path;
+                textures.push_back(t);
+            }
+        }
+        std::vector<MeshCacheDependencyRecord> dependencyRecords;
+        for (const std::string &path : dependencies)
+        {
+            MeshCacheDependencyRecord d;
+            d.pathOffset = blob.size();
+            d.pathLength = path.size();
+            blob += path;
+            SourceInfo info;
+            bool exists = statSource(path, info);
+            d.mtime = exists ? info.mtime : -1;
+            d.size = exists ? info.size : 0;
+            d.hash = exists ? hashFile(path) : 0;
+            dependencyRecords.push_back(d);
+        }
+        h.blobSize = blob.size();
+        Layout l = layout(records.size(), textures.size(), lods.size(), meshlets.size(), dependencyRecords.size(), blob.size());
+        uint64_t offset = align(l.end);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+        {
+            records[i].vertexOffset = offset;
+            offset = align(offset + records[i].vertexCount * sizeof(PackedVertex));
+            records[i].indexOffset = offset;
+            offset = align(offset + records[i].indexCount * sizeof(unsigned int));
+        }
+
+        // write to a temporary file first so a crash never leaves a truncated cache behind
+        std::string cachePath = CachePath(sourcePath);
+        std::string tmpPath = cachePath + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+            out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(MeshCacheMeshRecord));
+            pad(out, l.textures);
+            out.write(reinterpret_cast<const char*>(textures.data()), textures.size() * sizeof(MeshCacheTextureRecord));
+            pad(out, l.lods);
+            out.write(reinterpret_cast<const char*>(lods.data()), lods.size() * sizeof(MeshLod));
+            pad(out, l.meshlets);
+            out.write(reinterpret_cast<const char*>(meshlets.data()), meshlets.size() * sizeof(Meshlet));
+            pad(out, l.dependencies);
+            out.write(reinterpret_cast<const char*>(dependencyRecords.data()),
+                      dependencyRecords.size() * sizeof(MeshCacheDependencyRecord));
+            pad(out, l.blob);
+            out.write(blob.data(), blob.size());
+            for (unsigned int i = 0; i < meshes.size(); i++)
+            {
+                pad(out, records[i].vertexOffset);
+                out.write(reinterpret_cast<const char*>(meshes[i].VertexData()), records[i].vertexCount * sizeof(PackedVertex));
+                pad(out, records[i].indexOffset);
+                out.write(reinterpret_cast<const char*>(meshes[i].IndexData()), records[i].indexCount * sizeof(unsigned int));
+            }
+            if (!out)
+                return false;
+        }
+        return std::rename(tmpPath.c_str(), cachePath.c_str()) == 0;
+    }
+
+private:
+    // where each table starts (offsets from the start of the file) and how many records it holds
+    struct Layout {
+        uint64_t textures, lods, meshlets, dependencies, blob, end;
+        uint64_t textureCount, lodCount, meshletCount;
+    };
+
+    const char *data;
+    size_t size;
+    Layout tables;
+
+    struct SourceInfo {
+        int64_t mtime;
+        uint64_t size;
+    };
+
+    // the tables in the order of the file layout above; Write() and locateTables() both go through this
+    static Layout layout(uint64_t meshCount, uint64_t textureCount, uint64_t lodCount, uint64_t meshletCount,
+                         uint64_t dependencyCount, uint64_t blobSize)
+    {
+        Layout l;
+        l.textureCount = textureCount;
+        l.lodCount = lodCount;
+        l.meshletCount = meshletCount;
+        l.textures = alignTable(sizeof(MeshCacheHeader) + meshCount * sizeof(MeshCacheMeshRecord));
+        l.lods = alignTable(l.textures + textureCount * sizeof(MeshCacheTextureRecord));
+        l.meshlets = alignTable(l.lods + lodCount * sizeof(MeshLod));
+        l.dependencies = alignTable(l.meshlets + meshletCount * sizeof(Meshlet));
+        l.blob = alignTable(l.dependencies + dependencyCount * sizeof(MeshCacheDependencyRecord));
+        l.end = l.blob + blobSize;
+        return l;
+    }
+
+    // finds the tables from the per-mesh counts; false if they do not all fit in the mapping. Nothing past
+    // the mesh records is read before this succeeded.
+    bool locateTables()
+    {
+        const MeshCacheHeader &h = header();
+        if (sizeof(MeshCacheHeader) + (uint64_t)h.meshCount * sizeof(MeshCacheMeshRecord) > size)
+            return false;
+        // a table of more records than the file has bytes cannot fit; stopping there keeps the sums and the
+        // offsets computed from them far from overflowing
+        uint64_t textureCount = 0, lodCount = 0, meshletCount = 0;
+        for (unsigned int i = 0; i < h.meshCount; i++)
+        {
+            textureCount += meshRecord(i).textureCount;
+            lodCount += meshRecord(i).lodCount;
+            meshletCount += meshRecord(i).meshletCount;
+            if (textureCount > size || lodCount > size || meshletCount > size)
+                return false;
+        }
+        tables = layout(h.meshCount, textureCount, lodCount, meshletCount, h.dependencyCount, h.blobSize);
+        return tables.end <= size;
+    }
+
+    const MeshCacheHeader &header() const
+    {
+        return *reinterpret_cast<const MeshCacheHeader*>(data);
+    }
+
+    const MeshCacheMeshRecord &meshRecord(unsigned int i) const
+    {
+        return reinterpret_cast<const MeshCacheMeshRecord*>(data + sizeof(MeshCacheHeader))[i];
+    }
+
+    const MeshCacheTextureRecord *textureRecords() const
+    {
+        return reinterpret_cast<const MeshCacheTextureRecord*>(data + tables.textures);
+    }
+
+    const MeshLod *lodRecords() const
+    {
+        return reinterpret_cast<const MeshLod*>(data + tables.lods);
+    }
+
+    const Meshlet *meshletRecords() const
+    {
+        return reinterpret_cast<const Meshlet*>(data + tables.meshlets);
+    }
+
+    const MeshCacheDependencyRecord *dependencyRecords() const
+    {
+        return reinterpret_cast<const MeshCacheDependencyRecord*>(data + tables.dependencies);
+    }
+
+    const char *stringBlob() const
+    {
+        return data + tables.blob;
+    }
+
+    // the records point inside the mapping and their tables; the tables themselves were placed by locateTables()
+    bool recordsInBounds() const
+    {
+        for (unsigned int i = 0; i < header().meshCount; i++)
+        {
+            const MeshCacheMeshRecord &mesh = meshRecord(i);
+            if (!arrayInFile<PackedVertex>(mesh.vertexOffset, mesh.vertexCount)
+                    || !arrayInFile<unsigned int>(mesh.indexOffset, mesh.indexCount))
+                return false;
+        }
+        // every string lies inside the blob
+        for (unsigned int i = 0; i < header().dependencyCount; i++)
+        {
+            const MeshCacheDependencyRecord &dependency = dependencyRecords()[i];
+            if (!stringInBlob(dependency.pathOffset, dependency.pathLength))
+                return false;
+        }
+        for (uint64_t i = 0; i < tables.textureCount; i++)
+        {
+            const MeshCacheTextureRecord &texture = textureRecords()[i];
+            if (!stringInBlob(texture.typeOffset, texture.typeLength) || !stringInBlob(texture.pathOffset, texture.pathLength))
+                return false;
+        }
+        for (unsigned int i = 0; i < header().meshCount; i++)
+        {
+            const MeshCacheMeshRecord &mesh = meshRecord(i);
+            if ((uint64_t)mesh.firstTexture + mesh.textureCount > tables.textureCount
+                    || (uint64_t)mesh.firstLod + mesh.lodCount > tables.lodCount
+                    || (uint64_t)mesh.firstMeshlet + mesh.meshletCount > tables.meshletCount)
+                return false;
+            for (unsigned int j = 0; j < mesh.lodCount; j++)
+            {
+                const MeshLod &lod = lodRecords()[mesh.firstLod + j];
+                if ((uint64_t)lod.indexOffset + lod.indexCount > mesh.indexCount)
+                    return false;
+            }
+            for (unsigned int j = 0; j < mesh.meshletCount; j++)
+            {
+                const Meshlet &meshlet = meshletRecords()[mesh.firstMeshlet + j];
+                if ((uint64_t)meshlet.indexOffset + meshlet.indexCount > mesh.indexCount)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    // count aligned elements of type T at offset fit in the mapping, written so that nothing can overflow
+    template<typename T>
+    bool arrayInFile(uint64_t offset, uint64_t count) const
+    {
+        return offset % alignof(T) == 0 && offset <= size && count <= (size - offset) / sizeof(T);
+    }
+
+    bool stringInBlob(uint32_t offset, uint32_t length) const
+    {
+        return (uint64_t)offset + length <= header().blobSize;
+    }
+
+    // every dependency is still missing or still there with the content it had when the cache was written;
+    // like the source, a dependency is only hashed again when its mtime changed
+    bool dependenciesUnchanged() const
+    {
+        for (unsigned int i = 0; i < header().dependencyCount; i++)
+        {
+            const MeshCacheDependencyRecord &recorded = dependencyRecords()[i];
+            std::string path(stringBlob() + recorded.pathOffset, recorded.pathLength);
+            SourceInfo current;
+            if (!statSource(path, current))
+            {
+                if (recorded.mtime >= 0)
+                    return false;
+                continue;
+            }
+            if (recorded.mtime < 0 || current.size != recorded.size)
+                return false;
+            if (current.mtime != recorded.mtime && hashFile(path) != recorded.hash)
+                return false;
+        }
+        return true;
+    }
+
+    static bool statSource(const std::string &path, SourceInfo &info)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+            return false;
+        info.mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+        info.size = st.st_size;
+        return true;
+    }
+
+    // 64-bit FNV-1a over the whole source file
+    static uint64_t hashFile(const std::string &path)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        std::ifstream in(path, std::ios::binary);
+        char buffer[1 << 16];
+        while (in)
+        {
+            in.read(buffer, sizeof(buffer));
+            std::streamsize n = in.gcount();
+            for (std::streamsize i = 0; i < n; i++)
+            {
+                hash ^= (unsigned char)buffer[i];
+                hash *= 1099511628211ull;
+            }
+        }
+        return hash;
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 3) & ~(uint64_t)3;
+    }
+
+    static uint64_t alignTable(uint64_t offset)
+    {
+        const uint64_t a = alignof(uint64_t);
+        return (offset + a - 1) & ~(a - 1);
+    }
+
+    static void pad(std::ofstream &out, uint64_t offset)
+    {
+        static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+        uint64_t position = out.tellp();
+        out.write(zeros, offset - position);
+    }
+};
+
+#endif
@@ -0,0 +1,388 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+// Post-import optimisation of indexed triangle meshes. Everything here is CPU only and runs during import
+// (possibly on a worker thread), before the mesh cache is written:
+//
+//   WeldVertices         merges bitwise identical vertices (the import does not join them)
+//   OptimizeVertexCache  reorders triangles for the post-transform cache (Forsyth's linear-speed algorithm)
+//   OptimizeOverdraw     reorders clusters of triangles front-to-back-ish, as long as the cache order holds up
+//   OptimizeVertexFetch  renumbers vertices in first-use order so vertex fetches walk memory linearly
+//   SplitMesh            cuts a mesh into parts that each fit 16 bit indices
+namespace MeshOptimizer {
+
+    // efficiency of a triangle order for a FIFO post-transform cache
+    struct CacheStats {
+        size_t triangles = 0;
+        size_t vertices = 0;
+        size_t misses = 0;  // vertex shader invocations
+
+        // average cache miss ratio: transformed vertices per triangle (0.5 is ideal, 3 is no reuse at all)
+        float ACMR() const { return triangles ? (float)misses / triangles : 0.0f; }
+        // average transform to vertex ratio: 1 means every vertex is shaded exactly once
+        float ATVR() const { return vertices ? (float)misses / vertices : 0.0f; }
+
+        CacheStats &operator+=(const CacheStats &other)
+        {
+            triangles += other.triangles;
+            vertices += other.vertices;
+            misses += other.misses;
+            return *this;
+        }
+    };
+
+    static const unsigned int AnalyzeCacheSize = 16;
+
+    inline CacheStats AnalyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                         unsigned int cacheSize = AnalyzeCacheSize)
+    {
+        CacheStats stats;
+        stats.triangles = indices.size() / 3;
+        stats.vertices = vertexCount;
+        // FIFO: a vertex is in the cache if it was pushed fewer than cacheSize misses ago
+        std::vector<size_t> pushedAt(vertexCount, 0);
+        size_t time = cacheSize + 1;
+        for (unsigned int index : indices)
+        {
+            if (time - pushedAt[index] > cacheSize)
+            {
+                pushedAt[index] = time++;
+                stats.misses++;
+            }
+        }
+        return stats;
+    }
+
+    // merges vertices whose attributes are bitwise identical and rewrites the indices to match
+    inline void WeldVertices(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+    {
+        struct VertexHash {
+            size_t operator()(const Vertex &v) const
+            {
+                // FNV-1a over the raw attribute bytes
+                const unsigned char *bytes = reinterpret_cast<const unsigned char*>(&v);
+                uint64_t hash = 14695981039346656037ull;
+                for (size_t i = 0; i < sizeof(Vertex); i++)
+                {
+                    hash ^= bytes[i];
+                    hash *= 1099511628211ull;
+                }
+                return hash;
+            }
+        };
+        struct VertexEqual {
+            bool operator()(const Vertex &a, const Vertex &b) const
+            {
+                return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+            }
+        };
+
+        std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique;
+        unique.reserve(vertices.size());
+        std::vector<unsigned int> remap(vertices.size());
+        std::vector<Vertex> welded;
+        welded.reserve(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            auto inserted = unique.insert(std::make_pair(vertices[i], (unsigned int)welded.size()));
+            if (inserted.second)
+                welded.push_back(vertices[i]);
+            remap[i] = inserted.first->second;
+        }
+        for (unsigned int &index : indices)
+            index = remap[index];
+        vertices.swap(welded);
+    }
+
+    // Tom Forsyth, "Linear-Speed Vertex Cache Optimisation" (2006). Greedily emits the triangle with the best
+    // score, where vertices score high when they are recently used (in a modelled LRU cache) and when few
+    // triangles still need them, so that vertices are finished off instead of being left behind.
+    inline void OptimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount)
+    {
+        const int cacheSize = 32;
+        const float cacheDecayPower = 1.5f;
+        const float lastTriangleScore = 0.75f;
+        const float valenceBoostScale = 2.0f;
+        const float valenceBoostPower = 0.5f;
+
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return;
+
+        // triangles adjacent to each vertex, as one flat array
+        std::vector<unsigned int> valence(vertexCount, 0);
+        for (unsigned int index : indices)
+            valence[index]++;
+        std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyOffset[v + 1] = adjacencyOffset[v] + valence[v];
+        std::vector<unsigned int> adjacency(indices.size());
+        {
+            std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (size_t t = 0; t < triangleCount; t++)
+                for (int k = 0; k < 3; k++)
+                    adjacency[fill[indices[3 * t + k]]++] = t;
+        }
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<unsigned int> remaining(valence);
+        auto vertexScore = [&](unsigned int v) {
+            if (remaining[v] == 0)
+                return -1.0f;
+            float score = 0.0f;
+            int position = cachePosition[v];
+            if (position >= 0)
+            {
+                if (position < 3)
+                    score = lastTriangleScore;
+                else
+                    score = std::pow(1.0f - (float)(position - 3) / (cacheSize - 3), cacheDecayPower);
+            }
+            return score + valenceBoostScale * std::pow((float)remaining[v], -valenceBoostPower);
+        };
+
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            vertexScores[v] = vertexScore(v);
+        std::vector<float> triangleScores(triangleCount);
+        std::vector<bool> emitted(triangleCount, false);
+        for (size_t t = 0; t < triangleCount; t++)
+            triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        std::vector<unsigned int> cache, nextCache;
+        size_t cursor = 0;  // scan position for restarting when nothing in the cache has triangles left
+        long best = std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+
+        while (best >= 0)
+        {
+            emitted[best] = true;
+            const unsigned int *tri = &indices[3 * best];
+            result.insert(result.end(), tri, tri + 3);
+
+            // the triangle's vertices move to the front of the cache, the rest shifts back
+            nextCache.assign(tri, tri + 3);
+            for (unsigned int v : cache)
+                if (v != tri[0] && v != tri[1] && v != tri[2])
+                    nextCache.push_back(v);
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = tri[k];
+                remaining[v]--;
+                // remove the triangle from the vertex's list of live triangles
+                unsigned int *first = &adjacency[adjacencyOffset[v]];
+                unsigned int *last = first + remaining[v] + 1;
+                *std::find(first, last, (unsigned int)best) = *(last - 1);
+            }
+
+            for (size_t i = 0; i < cache.size(); i++)
+                cachePosition[cache[i]] = -1;
+            for (size_t i = 0; i < nextCache.size(); i++)
+                cachePosition[nextCache[i]] = i < (size_t)cacheSize ? (int)i : -1;
+
+            // rescore every vertex that was or is in the cache, together with its live triangles
+            best = -1;
+            float bestScore = -1.0f;
+            for (unsigned int v : nextCache)
+            {
+                vertexScores[v] = vertexScore(v);
+                for (unsigned int i = 0; i < remaining[v]; i++)
+                {
+                    unsigned int t = adjacency[adjacencyOffset[v] + i];
+                    triangleScores[t] = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+                    if (triangleScores[t] > bestScore)
+                    {
+                        bestScore = triangleScores[t];
+                        best = t;
+                    }
+                }
+            }
+            if (nextCache.size() > (size_t)cacheSize)
+                nextCache.resize(cacheSize);
+            cache.swap(nextCache);
+
+            if (best < 0)
+            {
+                while (cursor < triangleCount && emitted[cursor])
+                    cursor++;
+                if (cursor < triangleCount)
+                    best = cursor;
+            }
+        }
+        indices.swap(result);
+    }
+
+    // Splits the (cache optimised) triangle order into clusters at points where the cache starts over, then
+    // draws clusters that face away from the mesh centre first: they tend to occlude the rest of the mesh.
+    // The new order is kept only if the ACMR grows by less than the given factor.
+    inline void OptimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<Vertex> &vertices, float threshold = 1.05f)
+    {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount < 2)
+            return;
+
+        // cluster boundaries: triangles whose three vertices all miss the cache
+        std::vector<size_t> clusterStart;
+        std::vector<size_t> pushedAt(vertices.size(), 0);
+        size_t time = AnalyzeCacheSize + 1;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            int misses = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int index = indices[3 * t + k];
+                if (time - pushedAt[index] > AnalyzeCacheSize)
+                {
+                    pushedAt[index] = time++;
+                    misses++;
+                }
+            }
+            if (t == 0 || misses == 3)
+                clusterStart.push_back(t);
+        }
+        if (clusterStart.size() < 2)
+            return;
+        clusterStart.push_back(triangleCount);
+
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+        std::vector<glm::vec3> clusterCentroid(clusterStart.size() - 1), clusterNormal(clusterStart.size() - 1);
+        for (size_t c = 0; c + 1 < clusterStart.size(); c++)
+        {
+            glm::vec3 centroid(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+            {
+                const glm::vec3 &a = vertices[indices[3 * t]].Position;
+                const glm::vec3 &b = vertices[indices[3 * t + 1]].Position;
+                const glm::vec3 &p = vertices[indices[3 * t + 2]].Position;
+                glm::vec3 n = glm::cross(b - a, p - a);
+                float triangleArea = glm::length(n);
+                centroid += (a + b + p) * (triangleArea / 3.0f);
+                normal += n;
+                area += triangleArea;
+            }
+            meshCentroid += centroid;
+            meshArea += area;
+            clusterCentroid[c] = area > 0.0f ? centroid / area : centroid;
+            float length = glm::length(normal);
+            clusterNormal[c] = length > 0.0f ? normal / length : normal;
+        }
+        if (meshArea > 0.0f)
+            meshCentroid /= meshArea;
+
+        std::vector<float> sortKey(clusterCentroid.size());
+        for (size_t c = 0; c < sortKey.size(); c++)
+            sortKey[c] = glm::dot(clusterCentroid[c] - meshCentroid, clusterNormal[c]);
+        std::vector<size_t> order(sortKey.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+        std::vector<unsigned int> sorted;
+        sorted.reserve(indices.size());
+        for (size_t c : order)
+            sorted.insert(sorted.end(), indices.begin() + 3 * clusterStart[c], indices.begin() + 3 * clusterStart[c + 1]);
+
+        if (AnalyzeVertexCache(sorted, vertices.size()).ACMR() <= AnalyzeVertexCache(indices, vertices.size()).ACMR() * threshold)
+            indices.swap(sorted);
+    }
+
+    // renumbers vertices in the order the indices first reference them; unreferenced vertices are dropped
+    inline void OptimizeVertexFetch(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+    {
+        const unsigned int unused = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), unused);
+        std::vector<Vertex> ordered;
+        ordered.reserve(vertices.size());
+        for (unsigned int &index : indices)
+        {
+            if (remap[index] == unused)
+            {
+                remap[index] = ordered.size();
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(ordered);
+    }
+
+    // one part of a split mesh
+    struct MeshPart {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+    };
+
+    // cuts the mesh into parts of at most maxVertices vertices, walking the triangles in their current
+    // (cache optimised) order so every part stays a contiguous, cache friendly run of triangles
+    inline std::vector<MeshPart> SplitMesh(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                           size_t maxVertices = 65536)
+    {
+        std::vector<MeshPart> parts;
+        if (vertices.size() <= maxVertices)
+        {
+            parts.push_back(MeshPart{vertices, indices});
+            return parts;
+        }
+        const unsigned int unused = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), unused);
+        std::vector<unsigned int> touched;
+        parts.emplace_back();
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            int newVertices = 0;
+            for (int k = 0; k < 3; k++)
+                newVertices += remap[indices[t + k]] == unused;
+            if (parts.back().vertices.size() + newVertices > maxVertices)
+            {
+                for (unsigned int v : touched)
+                    remap[v] = unused;
+                touched.clear();
+                parts.emplace_back();
+            }
+            MeshPart &part = parts.back();
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int index = indices[t + k];
+                if (remap[index] == unused)
+                {
+                    remap[index] = part.vertices.size();
+                    part.vertices.push_back(vertices[index]);
+                    touched.push_back(index);
+                }
+                part.indices.push_back(remap[index]);
+            }
+        }
+        return parts;
+    }
+
+    struct Result {
+        CacheStats before;
+        CacheStats after;
+    };
+
+    // the full pipeline, in the order the passes depend on each other
+    inline Result OptimizeMesh(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+    {
+        Result result;
+        result.before = AnalyzeVertexCache(indices, vertices.size());
+        WeldVertices(vertices, indices);
+        OptimizeVertexCache(indices, vertices.size());
+        OptimizeOverdraw(indices, vertices);
+        OptimizeVertexFetch(vertices, indices);
+        result.after = AnalyzeVertexCache(indices, vertices.size());
+        return result;
+    }
+}
+
+#endif
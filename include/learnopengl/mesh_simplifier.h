@@ -0,0 +1,245 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Level of detail generation for indexed triangle meshes, CPU only, run during import before packing.
+//
+// Simplify is Garland and Heckbert's quadric error simplification ("Surface Simplification Using Quadric
+// Error Metrics", 1997) restricted to half-edge collapses: a vertex is merged into one of its neighbours,
+// so no new vertices are created and every LOD indexes the vertex buffer of the full detail mesh.
+// Vertices on an open edge are never moved. Since a UV seam (or a hard normal edge) is two rows of vertices
+// that share positions but not attributes, its edges are open in index space, so seams keep their exact
+// shape and texture mapping; the same goes for the borders of meshes cut by SplitMesh.
+namespace MeshSimplifier {
+
+    // squared distance to a set of planes, weighted by the area of the triangles they came from
+    struct Quadric {
+        double a2 = 0, b2 = 0, c2 = 0, d2 = 0, ab = 0, ac = 0, ad = 0, bc = 0, bd = 0, cd = 0;
+        double weight = 0;
+
+        static Quadric FromPlane(const glm::vec3 &n, float d, float weight)
+        {
+            Quadric q;
+            q.a2 = n.x * n.x * weight; q.b2 = n.y * n.y * weight; q.c2 = n.z * n.z * weight; q.d2 = d * d * weight;
+            q.ab = n.x * n.y * weight; q.ac = n.x * n.z * weight; q.ad = n.x * d * weight;
+            q.bc = n.y * n.z * weight; q.bd = n.y * d * weight; q.cd = n.z * d * weight;
+            q.weight = weight;
+            return q;
+        }
+
+        Quadric &operator+=(const Quadric &o)
+        {
+            a2 += o.a2; b2 += o.b2; c2 += o.c2; d2 += o.d2; ab += o.ab; ac += o.ac; ad += o.ad;
+            bc += o.bc; bd += o.bd; cd += o.cd; weight += o.weight;
+            return *this;
+        }
+
+        // mean squared distance of p to the planes
+        double Error(const glm::vec3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double e = a2 * x * x + b2 * y * y + c2 * z * z + d2
+                     + 2.0 * (ab * x * y + ac * x * z + ad * x + bc * y * z + bd * y + cd * z);
+            return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+        }
+    };
+
+    // removes collapses until the index count reaches targetIndexCount or the next collapse would move the
+    // surface by more than targetError (object space units). The error of the result goes to resultError.
+    inline std::vector<unsigned int> Simplify(const std::vector<Vertex> &vertices, const std::vector<unsigned int> &indices,
+                                              size_t targetIndexCount, float targetError, float *resultError = nullptr)
+    {
+        std::vector<unsigned int> result(indices);
+        size_t vertexCount = vertices.size();
+
+        std::vector<Quadric> quadrics(vertexCount);
+        for (size_t t = 0; t + 2 < indices.size(); t += 3)
+        {
+            const glm::vec3 &p0 = vertices[indices[t]].Position;
+            glm::vec3 normal = glm::cross(vertices[indices[t + 1]].Position - p0, vertices[indices[t + 2]].Position - p0);
+            float area = glm::length(normal);
+            if (area == 0.0f)
+                continue;
+            normal /= area;
+            Quadric q = Quadric::FromPlane(normal, -glm::dot(normal, p0), area * 0.5f);
+            for (int k = 0; k < 3; k++)
+                quadrics[indices[t + k]] += q;
+        }
+
+        // vertices on an edge used by anything but exactly two triangles stay where they are
+        std::vector<bool> locked(vertexCount, false);
+        {
+            std::unordered_map<uint64_t, unsigned int> edgeUse;
+            edgeUse.reserve(indices.size());
+            auto key = [](unsigned int a, unsigned int b) { return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a; };
+            for (size_t t = 0; t + 2 < indices.size(); t += 3)
+                for (int k = 0; k < 3; k++)
+                    edgeUse[key(indices[t + k], indices[t + (k + 1) % 3])]++;
+            for (const auto &edge : edgeUse)
+            {
+                if (edge.second != 2)
+                {
+                    locked[edge.first >> 32] = true;
+                    locked[edge.first & 0xFFFFFFFFu] = true;
+                }
+            }
+        }
+
+        struct Collapse {
+            unsigned int from, to;
+            double error;
+        };
+        double maxError = targetError * (double)targetError;
+        double reachedError = 0.0;
+        std::vector<unsigned int> remap(vertexCount);
+        std::vector<bool> touched(vertexCount);
+        // every pass collapses a set of edges whose neighbourhoods do not overlap, then rebuilds
+        while (result.size() > targetIndexCount)
+        {
+            // triangles around each vertex
+            std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+            for (unsigned int index : result)
+                adjacencyOffset[index + 1]++;
+            for (size_t v = 0; v < vertexCount; v++)
+                adjacencyOffset[v + 1] += adjacencyOffset[v];
+            std::vector<unsigned int> adjacency(result.size());
+            {
+                std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+                for (size_t i = 0; i < result.size(); i++)
+                    adjacency[fill[result[i]]++] = i / 3;
+            }
+
+            std::vector<Collapse> collapses;
+            for (size_t t = 0; t + 2 < result.size(); t += 3)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int from = result[t + k], to = result[t + (k + 1) % 3];
+                    // each interior edge shows up once per direction, so both endpoints get a chance
+                    if (locked[from])
+                        continue;
+                    Quadric merged = quadrics[from];
+                    merged += quadrics[to];
+                    collapses.push_back(Collapse{from, to, merged.Error(vertices[to].Position)});
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) { return a.error < b.error; });
+
+            for (size_t v = 0; v < vertexCount; v++)
+                remap[v] = v;
+            std::fill(touched.begin(), touched.end(), false);
+            size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+            size_t removed = 0;
+            bool collapsed = false;
+            for (const Collapse &c : collapses)
+            {
+                if (c.error > maxError || removed >= trianglesToRemove)
+                    break;
+                if (touched[c.from] || touched[c.to])
+                    continue;
+                // the triangles that keep existing must not flip over
+                const glm::vec3 &target = vertices[c.to].Position;
+                bool flips = false;
+                size_t dropped = 0;
+                for (unsigned int i = adjacencyOffset[c.from]; i < adjacencyOffset[c.from + 1] && !flips; i++)
+                {
+                    const unsigned int *tri = &result[3 * adjacency[i]];
+                    if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to)
+                    {
+                        dropped++;
+                        continue;
+                    }
+                    glm::vec3 p[3], moved[3];
+                    for (int k = 0; k < 3; k++)
+                    {
+                        p[k] = vertices[tri[k]].Position;
+                        moved[k] = tri[k] == c.from ? target : p[k];
+                    }
+                    glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                    glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                    // more than ~75 degrees of rotation counts as well, or slivers flip over a few passes later
+                    flips = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+                }
+                if (flips)
+                    continue;
+                remap[c.from] = c.to;
+                quadrics[c.to] += quadrics[c.from];
+                // lock the neighbourhood for the rest of the pass, its triangles are out of date now
+                for (unsigned int i = adjacencyOffset[c.from]; i < adjacencyOffset[c.from + 1]; i++)
+                    for (int k = 0; k < 3; k++)
+                        touched[result[3 * adjacency[i] + k]] = true;
+                removed += dropped;
+                reachedError = std::max(reachedError, c.error);
+                collapsed = true;
+            }
+            if (!collapsed)
+                break;
+
+            size_t write = 0;
+            for (size_t t = 0; t + 2 < result.size(); t += 3)
+            {
+                unsigned int a = remap[result[t]], b = remap[result[t + 1]], c = remap[result[t + 2]];
+                if (a == b || b == c || a == c)
+                    continue;
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+            result.resize(write);
+        }
+        if (resultError)
+            *resultError = (float)std::sqrt(reachedError);
+        return result;
+    }
+
+    static const unsigned int MaxLods = 4;
+
+    // Builds up to MaxLods levels, each with about half the triangles of the one before, every level
+    // simplified from the full mesh. The chain ends early when a level would deviate from the surface by
+    // more than maxRelativeError of the mesh's size, or when simplification stops making progress.
+    // Returns the index lists of all levels (the first one is indices itself) and their errors.
+    inline std::vector<std::vector<unsigned int>> BuildLodChain(const std::vector<Vertex> &vertices,
+                                                                const std::vector<unsigned int> &indices,
+                                                                std::vector<float> &errors,
+                                                                float maxRelativeError = 0.05f)
+    {
+        std::vector<std::vector<unsigned int>> levels(1, indices);
+        errors.assign(1, 0.0f);
+        if (vertices.empty())
+            return levels;
+        glm::vec3 low = vertices[0].Position, high = low;
+        for (const Vertex &v : vertices)
+        {
+            low = glm::min(low, v.Position);
+            high = glm::max(high, v.Position);
+        }
+        float maxError = glm::length(high - low) * maxRelativeError;
+
+        for (unsigned int level = 1; level < MaxLods; level++)
+        {
+            size_t previous = levels.back().size();
+            size_t target = (indices.size() >> level) / 3 * 3;
+            if (target < 3 * 16)
+                break;
+            float error;
+            std::vector<unsigned int> simplified = Simplify(vertices, indices, target, maxError, &error);
+            // less than 10% fewer triangles than the level before is not worth a level of its own
+            if (simplified.empty() || simplified.size() * 10 > previous * 9)
+                break;
+            MeshOptimizer::OptimizeVertexCache(simplified, vertices.size());
+            levels.push_back(std::move(simplified));
+            errors.push_back(error);
+        }
+        return levels;
+    }
+}
+
+#endif
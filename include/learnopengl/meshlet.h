@@ -0,0 +1,210 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/render_view.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// A small cluster of a mesh's triangles with its bounds, so the CPU can skip clusters that are off screen
+// or face away from the camera and draw the rest as index sub-ranges.
+struct Meshlet {
+    uint32_t indexOffset;       // first index of the cluster, relative to the mesh
+    uint32_t indexCount;
+    float    center[3];         // bounding sphere
+    float    radius;
+    float    coneAxis[3];       // average facing of the triangles
+    float    coneCutoff;        // sine of the widest angle between the axis and a triangle normal; 1 if that is 90 degrees or more
+};
+
+static_assert(sizeof(Meshlet) == 40, "Meshlet is stored in the mesh cache as is");
+
+// triangles rejected by meshlet culling, reset by the application every frame
+class CullStats
+{
+public:
+    size_t trianglesTested = 0;
+    size_t trianglesFrustumCulled = 0;
+    size_t trianglesBackfaceCulled = 0;
+    size_t meshletsTested = 0;
+    size_t meshletsCulled = 0;
+
+    static CullStats &Get()
+    {
+        static CullStats stats;
+        return stats;
+    }
+
+    void Reset() { *this = CullStats(); }
+};
+
+namespace Meshlets {
+
+    static const unsigned int MaxVertices = 64;
+    static const unsigned int MaxTriangles = 124;
+    // smaller meshes are drawn whole, a handful of clusters would not pay for the culling
+    static const size_t MinTriangles = 4 * MaxTriangles;
+
+    // Greedily grows clusters of at most MaxVertices vertices and MaxTriangles triangles over the mesh
+    // surface: the next triangle is the adjacent one that adds the fewest new vertices, ties going to the one
+    // that bends the cluster's normal cone the least. indices are reordered so every meshlet is a
+    // contiguous run of them. position(i) returns the position of vertex i.
+    template<typename GetPosition>
+    std::vector<Meshlet> Build(std::vector<unsigned int> &indices, size_t vertexCount, GetPosition position)
+    {
+        std::vector<Meshlet> meshlets;
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return meshlets;
+
+        std::vector<glm::vec3> normals(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            glm::vec3 p0 = position(indices[3 * t]);
+            glm::vec3 n = glm::cross(position(indices[3 * t + 1]) - p0, position(indices[3 * t + 2]) - p0);
+            float length = glm::length(n);
+            normals[t] = length > 0.0f ? n / length : glm::vec3(0.0f);
+        }
+
+        // triangles around each vertex
+        std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+        for (unsigned int index : indices)
+            adjacencyOffset[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyOffset[v + 1] += adjacencyOffset[v];
+        std::vector<unsigned int> adjacency(indices.size());
+        {
+            std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+            for (size_t i = 0; i < indices.size(); i++)
+                adjacency[fill[indices[i]]++] = i / 3;
+        }
+
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> inMeshlet(vertexCount, ~0u);    // meshlet a vertex was last added to
+        std::vector<unsigned int> ordered;
+        ordered.reserve(indices.size());
+        std::vector<unsigned int> meshletVertices;
+        size_t seed = 0;
+        while (true)
+        {
+            while (seed < triangleCount && emitted[seed])
+                seed++;
+            if (seed == triangleCount)
+                break;
+
+            unsigned int id = meshlets.size();
+            Meshlet meshlet = Meshlet();
+            meshlet.indexOffset = ordered.size();
+            meshletVertices.clear();
+            glm::vec3 normalSum(0.0f);
+            size_t next = seed;
+            while (next != triangleCount)
+            {
+                emitted[next] = true;
+                normalSum += normals[next];
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int v = indices[3 * next + k];
+                    ordered.push_back(v);
+                    if (inMeshlet[v] != id)
+                    {
+                        inMeshlet[v] = id;
+                        meshletVertices.push_back(v);
+                    }
+                }
+                meshlet.indexCount += 3;
+                if (meshlet.indexCount / 3 >= MaxTriangles)
+                    break;
+
+                // best triangle around the cluster's vertices
+                glm::vec3 axis = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+                next = triangleCount;
+                int bestNew = 4;
+                float bestFacing = -2.0f;
+                for (unsigned int v : meshletVertices)
+                {
+                    for (unsigned int i = adjacencyOffset[v]; i < adjacencyOffset[v + 1]; i++)
+                    {
+                        unsigned int t = adjacency[i];
+                        if (emitted[t])
+                            continue;
+                        int added = 0;
+                        for (int k = 0; k < 3; k++)
+                            added += inMeshlet[indices[3 * t + k]] != id;
+                        if (meshletVertices.size() + added > MaxVertices)
+                            continue;
+                        float facing = glm::dot(axis, normals[t]);
+                        if (added < bestNew || (added == bestNew && facing > bestFacing))
+                        {
+                            bestNew = added;
+                            bestFacing = facing;
+                            next = t;
+                        }
+                    }
+                }
+            }
+
+            // bounds: sphere around the box of the vertices, cone around the triangle normals
+            glm::vec3 low = position(meshletVertices[0]), high = low;
+            for (unsigned int v : meshletVertices)
+            {
+                low = glm::min(low, position(v));
+                high = glm::max(high, position(v));
+            }
+            glm::vec3 center = (low + high) * 0.5f;
+            float radius = 0.0f;
+            for (unsigned int v : meshletVertices)
+                radius = std::max(radius, glm::length(position(v) - center));
+            glm::vec3 axis = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+            float minFacing = 1.0f;
+            for (uint32_t i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount; i += 3)
+            {
+                const unsigned int *tri = &ordered[i];
+                glm::vec3 n = glm::cross(position(tri[1]) - position(tri[0]), position(tri[2]) - position(tri[0]));
+                if (glm::length(n) > 0.0f)
+                    minFacing = std::min(minFacing, glm::dot(axis, glm::normalize(n)));
+            }
+            for (int k = 0; k < 3; k++)
+            {
+                meshlet.center[k] = center[k];
+                meshlet.coneAxis[k] = axis[k];
+            }
+            meshlet.radius = radius;
+            meshlet.coneCutoff = minFacing > 0.0f ? std::sqrt(1.0f - minFacing * minFacing) : 1.0f;
+            meshlets.push_back(meshlet);
+        }
+        indices.swap(ordered);
+        return meshlets;
+    }
+
+    enum Visibility {
+        VISIBLE,
+        OUTSIDE_FRUSTUM,
+        BACKFACING
+    };
+
+    // view is in the mesh's object space
+    inline Visibility Cull(const Meshlet &meshlet, const CullView &view)
+    {
+        glm::vec3 center(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+        for (const glm::vec4 &plane : view.planes)
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -meshlet.radius)
+                return OUTSIDE_FRUSTUM;
+        // every triangle faces away when the whole sphere is inside the cone's "back" region
+        // (the conservative form without a cone apex, see meshoptimizer's meshopt_computeMeshletBounds)
+        if (meshlet.coneCutoff < 1.0f)
+        {
+            glm::vec3 axis(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+            glm::vec3 toCenter = center - view.cameraPosition;
+            if (glm::dot(toCenter, axis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius)
+                return BACKFACING;
+        }
+        return VISIBLE;
+    }
+}
+
+#endif
@@ -0,0 +1,231 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <learnopengl/texture_compress.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <future>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// the levels below the base level of an uncompressed image, generated on the CPU
+struct MipChain {
+    struct Level {
+        int width;
+        int height;
+        size_t offset;      // into data
+    };
+    std::vector<Level> levels;      // level 1 down to 1x1, level 0 is the image itself
+    std::vector<unsigned char> data;
+
+    bool Empty() const { return levels.empty(); }
+    size_t ByteSize() const { return data.size(); }
+};
+
+// CPU replacement for glGenerateMipmap, which is slow on software GL stacks like llvmpipe and filters
+// differently from driver to driver. Every level is a 2x2 box filter of the one above, odd sizes repeat
+// the last row or column like TextureCompression::Downsample. The colour channels of sRGB textures are
+// averaged in linear space and normal maps are renormalized; everything else is plain 8 bit averaging,
+// done with SSE2 where the compiler targets it. Touches no GL state, so it is safe on worker threads.
+namespace MipGenerator {
+
+    // fewer rows than this per job are not worth handing to another thread
+    static const int MinRowsPerJob = 32;
+
+    struct SrgbTables {
+        float toLinear[256];
+        unsigned char fromLinear[4096];     // indexed by the linear value times 4095
+
+        SrgbTables()
+        {
+            for (int i = 0; i < 256; i++)
+                toLinear[i] = TextureCompression::srgbToLinear((unsigned char)i);
+            for (int i = 0; i < 4096; i++)
+                fromLinear[i] = TextureCompression::linearToSrgb(i / 4095.0f);
+        }
+    };
+
+    inline const SrgbTables &srgbTables()
+    {
+        static const SrgbTables tables;
+        return tables;
+    }
+
+    // whether a texture file holds a normal map, by the same naming convention the texture cooker uses
+    inline bool LooksLikeNormalMap(std::string path)
+    {
+        std::transform(path.begin(), path.end(), path.begin(), ::tolower);
+        return path.find("normal") != std::string::npos;
+    }
+
+    // the rows of each pair are averaged into out, w texels of components bytes each
+    inline void plainRow(const unsigned char *row0, const unsigned char *row1, int width, int components,
+                         unsigned char *out, int w)
+    {
+        int x = 0;
+#if defined(__SSE2__)
+        // widen to 16 bits, add the four texels and round: 2 RGBA or 8 single channel texels per step
+        const __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+        if (width > 1 && components == 4)
+        {
+            for (; x + 2 <= w; x += 2)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i*)(row0 + 8 * x));
+                __m128i b = _mm_loadu_si128((const __m128i*)(row1 + 8 * x));
+                __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+                sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+                _mm_storel_epi64((__m128i*)(out + 4 * x), _mm_packus_epi16(sum, sum));
+            }
+        }
+        else if (width > 1 && components == 1)
+        {
+            const __m128i low = _mm_set1_epi16(0x00FF);
+            for (; x + 8 <= w; x += 8)
+            {
+                __m128i a = _mm_loadu_si128((const __m128i*)(row0 + 2 * x));
+                __m128i b = _mm_loadu_si128((const __m128i*)(row1 + 2 * x));
+                __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_and_si128(a, low), _mm_srli_epi16(a, 8)),
+                                            _mm_add_epi16(_mm_and_si128(b, low), _mm_srli_epi16(b, 8)));
+                sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+                _mm_storel_epi64((__m128i*)(out + x), _mm_packus_epi16(sum, sum));
+            }
+        }
+#endif
+        for (; x < w; x++)
+        {
+            const unsigned char *t0 = row0 + std::min(2 * x, width - 1) * components;
+            const unsigned char *t1 = row0 + std::min(2 * x + 1, width - 1) * components;
+            const unsigned char *t2 = row1 + std::min(2 * x, width - 1) * components;
+            const unsigned char *t3 = row1 + std::min(2 * x + 1, width - 1) * components;
+            for (int k = 0; k < components; k++)
+                out[x * components + k] = (unsigned char)((t0[k] + t1[k] + t2[k] + t3[k] + 2) >> 2);
+        }
+    }
+
+    inline void srgbRow(const unsigned char *row0, const unsigned char *row1, int width, int components,
+                        unsigned char *out, int w)
+    {
+        const SrgbTables &tables = srgbTables();
+        for (int x = 0; x < w; x++)
+        {
+            const unsigned char *t0 = row0 + std::min(2 * x, width - 1) * components;
+            const unsigned char *t1 = row0 + std::min(2 * x + 1, width - 1) * components;
+            const unsigned char *t2 = row1 + std::min(2 * x, width - 1) * components;
+            const unsigned char *t3 = row1 + std::min(2 * x + 1, width - 1) * components;
+            unsigned char *texel = out + x * components;
+            for (int k = 0; k < 3; k++)
+            {
+                float linear = tables.toLinear[t0[k]] + tables.toLinear[t1[k]] + tables.toLinear[t2[k]] + tables.toLinear[t3[k]];
+                texel[k] = tables.fromLinear[(int)(std::min(1.0f, linear * 0.25f) * 4095.0f + 0.5f)];
+            }
+            // alpha is coverage, not colour
+            if (components == 4)
+                texel[3] = (unsigned char)((t0[3] + t1[3] + t2[3] + t3[3] + 2) >> 2);
+        }
+    }
+
+    inline void normalRow(const unsigned char *row0, const unsigned char *row1, int width, int components,
+                          unsigned char *out, int w)
+    {
+        for (int x = 0; x < w; x++)
+        {
+            const unsigned char *t0 = row0 + std::min(2 * x, width - 1) * components;
+            const unsigned char *t1 = row0 + std::min(2 * x + 1, width - 1) * components;
+            const unsigned char *t2 = row1 + std::min(2 * x, width - 1) * components;
+            const unsigned char *t3 = row1 + std::min(2 * x + 1, width - 1) * components;
+            unsigned char *texel = out + x * components;
+            float n[3];
+            for (int k = 0; k < 3; k++)
+                n[k] = (t0[k] + t1[k] + t2[k] + t3[k]) * (2.0f / (4.0f * 255.0f)) - 1.0f;
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; k++)
+            {
+                float c = length > 1e-6f ? n[k] / length * 0.5f + 0.5f : (k == 2 ? 1.0f : 0.5f);
+                texel[k] = (unsigned char)std::lround(c * 255.0f);
+            }
+            if (components == 4)
+                texel[3] = (unsigned char)((t0[3] + t1[3] + t2[3] + t3[3] + 2) >> 2);
+        }
+    }
+
+    // rows [yBegin, yEnd) of the level below the width x height image src
+    inline void DownsampleRows(const unsigned char *src, int width, int height, int components, unsigned char *dst,
+                               int yBegin, int yEnd, bool srgb, bool normalMap)
+    {
+        int w = std::max(1, width / 2);
+        size_t srcStride = (size_t)width * components, dstStride = (size_t)w * components;
+        for (int y = yBegin; y < yEnd; y++)
+        {
+            const unsigned char *row0 = src + std::min(2 * y, height - 1) * srcStride;
+            const unsigned char *row1 = src + std::min(2 * y + 1, height - 1) * srcStride;
+            unsigned char *out = dst + y * dstStride;
+            if (normalMap && components >= 3)
+                normalRow(row0, row1, width, components, out, w);
+            else if (srgb && components >= 3)
+                srgbRow(row0, row1, width, components, out, w);
+            else
+                plainRow(row0, row1, width, components, out, w);
+        }
+    }
+
+    // Every level below the base one of a tightly packed 8 bit image with 1 to 4 channels. The levels depend
+    // on each other, so with a pool the rows of each level are split across its threads. The pool must not
+    // be one the caller is a worker of, since the caller waits for the jobs.
+    inline MipChain Generate(const unsigned char *pixels, int width, int height, int components,
+                             bool srgb, bool normalMap, ThreadPool *pool = nullptr)
+    {
+        MipChain chain;
+        if (!pixels || width <= 0 || height <= 0)
+            return chain;
+        size_t bytes = 0;
+        for (int w = width, h = height; w > 1 || h > 1; )
+        {
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+            chain.levels.push_back(MipChain::Level{w, h, bytes});
+            bytes += (size_t)w * h * components;
+        }
+        chain.data.resize(bytes);
+
+        const unsigned char *src = pixels;
+        int srcWidth = width, srcHeight = height;
+        for (const MipChain::Level &level : chain.levels)
+        {
+            unsigned char *dst = &chain.data[level.offset];
+            int jobs = pool ? std::min((int)pool->Size(), level.height / MinRowsPerJob) : 1;
+            if (jobs <= 1)
+            {
+                DownsampleRows(src, srcWidth, srcHeight, components, dst, 0, level.height, srgb, normalMap);
+            }
+            else
+            {
+                std::vector<std::future<void>> bands;
+                for (int i = 0; i < jobs; i++)
+                {
+                    int begin = level.height * i / jobs, end = level.height * (i + 1) / jobs;
+                    bands.push_back(pool->Submit([=] {
+                        DownsampleRows(src, srcWidth, srcHeight, components, dst, begin, end, srgb, normalMap);
+                    }));
+                }
+                for (std::future<void> &band : bands)
+                    band.get();
+            }
+            src = dst;
+            srcWidth = level.width;
+            srcHeight = level.height;
+        }
+        return chain;
+    }
+}
+
+#endif
@@ -9,22 +9,62 @@
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
+#include <assimp/version.h>
 
+#include <learnopengl/buffer_arena.h>
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
+#include <learnopengl/obj_loader.h>
+#include <learnopengl/process_memory.h>
+#include <learnopengl/render_view.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/stopwatch.h>
+#include <learnopengl/tangent_space.h>
+#include <learnopengl/texture.h>
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <atomic>
+#include <cmath>
+#include <limits>
 #include <map>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
 #include <vector>
 using namespace std;
 
+// loads (or reuses) a texture through the TextureRegistry; release it with TextureRegistry::Get().Release().
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
 
 
+class Model;
+
+// optional processing applied to imported meshes before they are cached; part of the mesh cache key
+enum MeshProcessing {
+    MESH_OPTIMIZE    = 1 << 0,    // weld, vertex cache, overdraw and vertex fetch optimisation (mesh_optimizer.h)
+    MESH_SPLIT_16BIT = 1 << 1,    // split meshes with more than 65536 vertices so all of them use 16 bit indices
+    MESH_LOD         = 1 << 2,    // build a chain of simplified levels of detail (mesh_simplifier.h)
+    MESH_MESHLETS    = 1 << 3     // cluster large meshes into meshlets for CPU culling (meshlet.h)
+};
+
+// CPU-side result of importing a model file. Produced without touching OpenGL so it can run on a worker
+// thread; when it comes from the mesh cache the arrays point into the mapped file.
+struct ModelImport
+{
+    unique_ptr<MeshCache> cache;
+    vector<MeshData> meshes;
+    bool loaded = false;
+    bool fromCache = false;
+    string importer;        // what produced the meshes, for the load report
+    double milliseconds = 0.0;
+};
+
 class Model
 {
 public:
@@ -33,47 +73,357 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    unsigned int meshProcessing;    // MeshProcessing flags
+    MeshResidency residency;        // where the meshes keep their geometry once loaded
+
+    // post-processing steps requested from Assimp; part of the mesh cache key. Tangents are not among them:
+    // TangentSpace generates MikkTSpace ones for every importer, one mesh per thread.
+    static const unsigned int ImportFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs;
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // The meshes are suballocated from one BufferArena sized for the model, or from sharedArena (e.g.
+    // BufferArena::Shared()) so several models draw from the same buffers.
+    Model(string const &path, bool gamma = false, unsigned int processing = MESH_OPTIMIZE | MESH_LOD | MESH_MESHLETS,
+          MeshResidency residency = MESH_GPU_ONLY, BufferArena *sharedArena = nullptr)
+        : gammaCorrection(gamma), meshProcessing(processing), residency(residency), arena(sharedArena), ready(false)
     {
         loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
-    void Draw(Shader &shader)
+    // starts importing the model on the shared thread pool and returns right away. The model draws a
+    // placeholder until StreamPending() has uploaded all of its geometry and textures.
+    static unique_ptr<Model> LoadAsync(string const &path, bool gamma = false, unsigned int processing = MESH_OPTIMIZE | MESH_LOD | MESH_MESHLETS,
+                                       MeshResidency residency = MESH_GPU_ONLY, BufferArena *sharedArena = nullptr)
     {
-        for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+        unique_ptr<Model> model(new Model(AsyncTag(), gamma, processing, residency, sharedArena));
+        model->path = path;
+        model->directory = path.substr(0, path.find_last_of('/'));
+        model->stream.reset(new StreamState);
+        shared_ptr<SharedStreamState> state = model->stream->shared;
+        ThreadPool::Shared().Submit([path, processing, state] {
+            importModel(path, processing, state->import);
+            state->imported = true;
+        });
+        streamingModels().push_back(model.get());
+        return model;
+    }
+
+    // textures are shared through the TextureRegistry, so a Model owns one reference to each of them
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+    ~Model()
+    {
+        vector<Model*> &streaming = streamingModels();
+        streaming.erase(std::remove(streaming.begin(), streaming.end(), this), streaming.end());
+        // the meshes give their ranges back to the arena, so they have to go first
+        meshes.clear();
+        for (const Texture &texture : textures_loaded)
+            if (texture.id)
+                TextureRegistry::Get().Release(texture.id);
+    }
+
+    bool IsReady() const { return ready; }
+
+    // projected simplification error, in pixels, below which a coarser level of detail is used
+    static constexpr float LodPixelError = 1.0f;
+    // the error has to be this much (relatively) below or above LodPixelError before the level changes,
+    // so an object at the boundary does not flip between two levels every frame
+    static constexpr float LodHysteresis = 0.25f;
+
+    // draws the model, and thus all its meshes, at full detail or at a level of detail chosen elsewhere (e.g.
+    // by this frame's main pass for an extra pass), without culling and without counting in CullStats
+    void Draw(Shader &shader, unsigned int lod = 0)
+    {
+        drawLevel(shader, lod);
+    }
+
+    // draws the model at the level of detail that fits its size on screen, leaving out the meshlets that are
+    // off screen or face away; transform is the model matrix the shader was given and state the level this
+    // instance had last frame
+    void Draw(Shader &shader, const RenderView &view, const glm::mat4 &transform, LodState &state)
+    {
+        if (ready)
+            state.level = selectLod(view, transform, state.level);
+        CullView cull = view.ObjectSpace(transform);
+        drawLevel(shader, state.level, &cull);
     }
 
+    unsigned int LodCount() const { return lodErrors.size(); }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
+        glslIdentifierPrefix = prefix;
         for (Mesh& mesh: meshes) {
             mesh.glslIdentifierPrefix = prefix;
         }
     }
-private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
-    void loadModel(string const &path)
+
+    // advances every asynchronous load, call once per frame on the GL thread. At most byteBudget bytes of
+    // vertices, indices and texels are uploaded per call (but always at least one piece of work, so large
+    // textures still make progress), keeping the frame time steady while assets stream in.
+    static void StreamPending(size_t byteBudget)
+    {
+        vector<Model*> streaming = streamingModels();
+        for (Model *model : streaming)
+        {
+            if (model->streamStep(byteBudget))
+            {
+                vector<Model*> &list = streamingModels();
+                list.erase(std::remove(list.begin(), list.end(), model), list.end());
+            }
+            if (byteBudget == 0)
+                break;
+        }
+    }
+
+    // reads the file with Assimp into one MeshData per aiMesh, without any MeshProcessing
+    static bool ImportWithAssimp(string const &path, vector<MeshData> &meshes)
     {
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene = importer.ReadFile(path, ImportFlags);
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
+        // process ASSIMP's root node recursively
+        size_t first = meshes.size();
+        processNode(scene->mRootNode, scene, meshes);
+        ThreadPool::Shared().ParallelFor(meshes.size() - first, [&meshes, first](size_t i) { TangentSpace::Generate(meshes[first + i]); });
+        return true;
+    }
+
+private:
+    // state shared with the background import job, which may outlive the Model
+    struct SharedStreamState {
+        ModelImport import;
+        std::atomic<bool> imported;
+        CompletionQueue<std::pair<size_t, TextureSource>> decoded;
+        SharedStreamState() : imported(false) {}
+    };
+
+    // progress of an asynchronous load, only touched on the GL thread
+    struct StreamState {
+        shared_ptr<SharedStreamState> shared;
+        bool started = false;
+        size_t mesh = 0;                // mesh currently being uploaded
+        size_t verticesUploaded = 0;
+        size_t indicesUploaded = 0;
+        size_t texturesPending = 0;     // decodes submitted but not uploaded yet
+        vector<string> textureKeys;
+        PixelUploadBuffer pixelBuffer;
+        Stopwatch timer;
+        unsigned int frames = 0;
+        StreamState() : shared(new SharedStreamState) {}
+    };
+
+    string path;
+    string glslIdentifierPrefix;
+    BufferArena *arena;                 // where the meshes live; null for CPU-only models
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+    vector<float> lodErrors;            // per level, the largest error of any mesh
+    unordered_map<string, size_t> textureSlots;     // textures_loaded index of each texture path
+    unique_ptr<BufferArena> ownArena;   // the model's own arena unless it was given a shared one
+    bool ready;
+    unique_ptr<StreamState> stream;
+
+    struct AsyncTag {};
+    Model(AsyncTag, bool gamma, unsigned int processing, MeshResidency residency, BufferArena *sharedArena)
+        : gammaCorrection(gamma), meshProcessing(processing), residency(residency), arena(sharedArena), ready(false) {}
+
+    static vector<Model*> &streamingModels()
+    {
+        static vector<Model*> models;
+        return models;
+    }
+
+    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // a valid mesh cache next to the file is used instead when there is one (warm start).
+    void loadModel(string const &path)
+    {
+        Stopwatch timer;
+        this->path = path;
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        ModelImport import;
+        if (!importModel(path, meshProcessing, import))
+            return;
+        createArena(import.meshes);
+        computeLodBounds(import.meshes);
+        meshes.reserve(import.meshes.size());
+        for (MeshData &data : import.meshes)
+        {
+            for (Texture &texture : data.textures)
+                texture = loadMaterialTexture(texture.path, texture.type);
+            meshes.emplace_back(std::move(data), residency, arena);
+        }
+        // nothing is drawn from CPU-only meshes, so their textures are not needed either
+        if (residency != MESH_CPU_ONLY)
+            loadPendingTextures();
+        ready = true;
+        cout << "Model: " << path << (import.fromCache ? " loaded from mesh cache in " : " imported with " + import.importer + " in ")
+             << timer.ElapsedMs() << " ms" << (import.fromCache ? " (warm)" : " (cold)") << ", " << residencyReport() << endl;
+    }
+
+    // CPU part of loading: maps the mesh cache if it is valid, otherwise imports the file (OBJ files with
+    // the ObjLoader fast path, everything else and OBJ files it cannot read with Assimp), applies the
+    // requested MeshProcessing and writes a new cache. Touches no GL state and no Model members, so it is
+    // safe on a worker thread.
+    static bool importModel(string const &path, unsigned int processing, ModelImport &import)
+    {
+        Stopwatch timer;
+        import.cache.reset(new MeshCache);
+        if (import.cache->Open(path, importerTag(path), ImportFlags, processing))
+        {
+            for (unsigned int i = 0; i < import.cache->MeshCount(); i++)
+                import.meshes.push_back(import.cache->GetMeshData(i));
+            import.fromCache = true;
+        }
+        else
+        {
+            import.cache.reset();
+            if (ObjLoader::IsObjFile(path) && ObjLoader::Load(path, import.meshes))
+                import.importer = "ObjLoader";
+            else if (ImportWithAssimp(path, import.meshes))
+                import.importer = "Assimp";
+            else
+                return false;
+            if (processing & MESH_OPTIMIZE)
+                optimizeMeshes(path, import.meshes);
+            if (processing & MESH_SPLIT_16BIT)
+                splitLargeMeshes(import.meshes);
+            // meshlets reorder the full detail triangles, the levels of detail are built from them afterwards
+            if (processing & MESH_MESHLETS)
+                buildMeshlets(path, import.meshes);
+            if (processing & MESH_LOD)
+                buildLods(path, import.meshes);
+            packMeshes(path, import.meshes);
+
+            vector<string> dependencies;
+            if (ObjLoader::IsObjFile(path))
+                dependencies = ObjLoader::MaterialLibraries(path);
+            if (!MeshCache::Write(path, importerTag(path), ImportFlags, processing, dependencies, import.meshes))
+                cout << "Model: could not write mesh cache " << MeshCache::CachePath(path) << endl;
+        }
+        import.loaded = true;
+        import.milliseconds = timer.ElapsedMs();
+        return true;
+    }
+
+    // tags the mesh cache with what imports path: OBJ files go through ObjLoader, which hands the ones it
+    // cannot read to Assimp, everything else straight to Assimp
+    static uint32_t importerTag(string const &path)
+    {
+        uint32_t assimp = aiGetVersionMajor() << 8 | aiGetVersionMinor();
+        if (ObjLoader::IsObjFile(path))
+            return ObjLoader::Version << 16 | assimp;
+        return assimp;
+    }
+
+    static void optimizeMeshes(string const &path, vector<MeshData> &meshes)
+    {
+        Stopwatch timer;
+        MeshOptimizer::CacheStats before, after;
+        for (MeshData &data : meshes)
+        {
+            MeshOptimizer::Result result = MeshOptimizer::OptimizeMesh(data.vertices, data.indices);
+            before += result.before;
+            after += result.after;
+        }
+        cout << "Model: optimized " << path << " in " << timer.ElapsedMs() << " ms: vertices " << before.vertices
+             << " -> " << after.vertices << ", ACMR " << before.ACMR() << " -> " << after.ACMR()
+             << ", ATVR " << before.ATVR() << " -> " << after.ATVR() << endl;
+    }
+
+    static void splitLargeMeshes(vector<MeshData> &meshes)
+    {
+        vector<MeshData> split;
+        for (MeshData &data : meshes)
+        {
+            if (Mesh::IndexTypeFor(data.vertices.size()) == GL_UNSIGNED_SHORT)
+            {
+                split.push_back(std::move(data));
+                continue;
+            }
+            for (MeshOptimizer::MeshPart &part : MeshOptimizer::SplitMesh(data.vertices, data.indices))
+            {
+                MeshData partData;
+                partData.vertices.swap(part.vertices);
+                partData.indices.swap(part.indices);
+                partData.textures = data.textures;
+                split.push_back(std::move(partData));
+            }
+        }
+        meshes.swap(split);
+    }
+
+    static void buildMeshlets(string const &path, vector<MeshData> &meshes)
+    {
+        Stopwatch timer;
+        size_t meshletCount = 0, clustered = 0;
+        for (MeshData &data : meshes)
+        {
+            if (data.indices.size() / 3 < Meshlets::MinTriangles)
+                continue;
+            const vector<Vertex> &vertices = data.vertices;
+            data.meshlets = Meshlets::Build(data.indices, vertices.size(),
+                                            [&vertices](unsigned int i) { return vertices[i].Position; });
+            // the clusters changed the order vertices are first used in
+            MeshOptimizer::OptimizeVertexFetch(data.vertices, data.indices);
+            meshletCount += data.meshlets.size();
+            clustered++;
+        }
+        cout << "Model: " << path << " split " << clustered << " of " << meshes.size() << " meshes into "
+             << meshletCount << " meshlets in " << timer.ElapsedMs() << " ms" << endl;
+    }
+
+    // appends the simplified levels to each mesh's indices
+    static void buildLods(string const &path, vector<MeshData> &meshes)
+    {
+        Stopwatch timer;
+        vector<size_t> triangles;
+        vector<float> errors;
+        for (MeshData &data : meshes)
+        {
+            vector<vector<unsigned int>> levels = MeshSimplifier::BuildLodChain(data.vertices, data.indices, errors);
+            data.indices.clear();
+            data.lods.clear();
+            for (size_t i = 0; i < levels.size(); i++)
+            {
+                data.lods.push_back(MeshLod{(uint32_t)data.indices.size(), (uint32_t)levels[i].size(), errors[i]});
+                data.indices.insert(data.indices.end(), levels[i].begin(), levels[i].end());
+                if (triangles.size() <= i)
+                    triangles.push_back(0);
+                triangles[i] += levels[i].size() / 3;
+            }
+        }
+        cout << "Model: built levels of detail for " << path << " in " << timer.ElapsedMs() << " ms, triangles";
+        for (size_t i = 0; i < triangles.size(); i++)
+            cout << (i ? " -> " : " ") << triangles[i];
+        cout << endl;
+    }
+
+    // converts the meshes to the GPU vertex layout, after which only the packed vertices are kept
+    static void packMeshes(string const &path, vector<MeshData> &meshes)
+    {
+        size_t vertexCount = 0, indexBytes = 0, indexCount = 0;
+        for (MeshData &data : meshes)
+        {
+            data.Pack();
+            vertexCount += data.VertexCount();
+            indexCount += data.IndexCount();
+            indexBytes += data.IndexCount() * (Mesh::IndexTypeFor(data.VertexCount()) == GL_UNSIGNED_SHORT ? 2 : 4);
+        }
+        cout << "Model: " << path << " vertex data " << vertexCount * sizeof(PackedVertex) / 1024 << " KiB packed ("
+             << vertexCount * sizeof(Vertex) / 1024 << " KiB as float), index data " << indexBytes / 1024 << " KiB ("
+             << indexCount * sizeof(unsigned int) / 1024 << " KiB as 32 bit)" << endl;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    static void processNode(aiNode *node, const aiScene *scene, vector<MeshData> &meshes)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -86,17 +436,18 @@ private:
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, meshes);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<Texture> &textures = data.textures;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
@@ -125,16 +476,6 @@ private:
                 vec.x = mesh->mTextureCoords[0][i].x;
                 vec.y = mesh->mTextureCoords[0][i].y;
                 vertex.TexCoords = vec;
-                // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
-                // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
             }
             else
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
@@ -178,41 +519,355 @@ private:
 
 
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data, the GPU side is created by the caller
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // checks all material textures of a given type and returns references to them (path and type).
+    // the textures themselves are loaded once all meshes of the model are known.
+    static vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
     {
         vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
+        }
+        return textures;
+    }
+
+    // registers a single material texture unless it was registered before. The returned texture has no
+    // GL id yet: the images are decoded together by loadPendingTextures() once all meshes are known.
+    Texture loadMaterialTexture(const string &path, const string &typeName)
+    {
+        // check if texture was loaded before and if so, skip loading a new texture
+        auto slot = textureSlots.find(path);
+        if (slot != textureSlots.end())
+            return textures_loaded[slot->second]; // a texture with the same filepath has already been loaded. (optimization)
+        Texture texture;
+        texture.id = 0;
+        texture.type = typeName;
+        texture.path = path;
+        textureSlots[path] = textures_loaded.size();
+        textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+        return texture;
+    }
+
+    // decodes every texture referenced by the model's materials in parallel, uploads them on this thread as
+    // they finish and patches the resulting ids into the meshes.
+    void loadPendingTextures()
+    {
+        vector<string> paths;
+        for (const Texture &texture : textures_loaded)
+            paths.push_back(directory + '/' + texture.path);
+        vector<unsigned int> ids = LoadTexturesParallel(paths, false);
+        for (unsigned int i = 0; i < textures_loaded.size(); i++)
+            textures_loaded[i].id = ids[i];
+        patchTextureIds();
+    }
+
+    void patchTextureIds()
+    {
+        for (Mesh &mesh : meshes)
+            for (Texture &texture : mesh.textures)
+            {
+                auto slot = textureSlots.find(texture.path);
+                texture.id = slot != textureSlots.end() ? textures_loaded[slot->second].id : 0;
+            }
+    }
+
+    // one frame of an asynchronous load; returns true once the model is complete.
+    bool streamStep(size_t &budget)
+    {
+        StreamState &s = *stream;
+        SharedStreamState &shared = *s.shared;
+        if (!shared.imported)
+            return false;
+        ModelImport &import = shared.import;
+        if (!import.loaded)
+        {
+            cout << "Model: asynchronous load of " << path << " failed" << endl;
+            stream.reset();
+            return true;
+        }
+        s.frames++;
+
+        if (!s.started)
+            startStreaming();
+
+        // geometry, one mesh after the other
+        while (budget > 0 && s.mesh < meshes.size())
+        {
+            const MeshData &data = import.meshes[s.mesh];
+            Mesh &mesh = meshes[s.mesh];
+            if (s.verticesUploaded < data.VertexCount())
+            {
+                size_t count = std::min(data.VertexCount() - s.verticesUploaded, std::max<size_t>(budget / sizeof(PackedVertex), 1));
+                mesh.UploadVertices(s.verticesUploaded, data.VertexData() + s.verticesUploaded, count);
+                s.verticesUploaded += count;
+                budget -= std::min(budget, count * sizeof(PackedVertex));
+            }
+            else if (s.indicesUploaded < data.IndexCount())
+            {
+                size_t count = std::min(data.IndexCount() - s.indicesUploaded, std::max<size_t>(budget / mesh.IndexSize(), 1));
+                mesh.UploadIndices(s.indicesUploaded, data.IndexData() + s.indicesUploaded, count);
+                s.indicesUploaded += count;
+                budget -= std::min(budget, count * mesh.IndexSize());
+            }
+            else
+            {
+                s.mesh++;
+                s.verticesUploaded = s.indicesUploaded = 0;
+            }
+        }
+
+        // textures, in the order their decodes finish
+        std::pair<size_t, TextureSource> decoded;
+        while (budget > 0 && s.texturesPending > 0 && shared.decoded.TryPop(decoded))
+        {
+            Texture &texture = textures_loaded[decoded.first];
+            if (decoded.second.IsValid())
+            {
+                texture.id = s.pixelBuffer.Upload(decoded.second, false);
+                budget -= std::min(budget, decoded.second.ByteSize());
+            }
+            else
+            {
+                cout << "Texture failed to load at path: " << directory + '/' + texture.path << endl;
+                glGenTextures(1, &texture.id);
+            }
+            TextureRegistry::Get().Insert(s.textureKeys[decoded.first], texture.id);
+            s.texturesPending--;
+        }
+
+        if (s.mesh < meshes.size() || s.texturesPending > 0)
+            return false;
+
+        if (residency == MESH_CPU_AND_GPU)
+            for (size_t i = 0; i < meshes.size(); i++)
+                meshes[i].KeepCPUCopy(std::move(import.meshes[i]));
+        patchTextureIds();
+        ready = true;
+        cout << "Model: " << path << (import.fromCache ? " loaded from mesh cache" : " imported with " + import.importer)
+             << " in " << import.milliseconds << " ms, streamed to the GPU over " << s.frames << " frames ("
+             << s.timer.ElapsedMs() << " ms in total), " << residencyReport() << endl;
+        // drops the CPU arrays (or the cache mapping) unless the import job still holds on to them; s and
+        // import are gone after this
+        stream.reset();
+        TextureStats::Get().Print();
+        return true;
+    }
+
+    // creates the (still empty) meshes and fans the texture decodes out to the thread pool
+    void startStreaming()
+    {
+        StreamState &s = *stream;
+        shared_ptr<SharedStreamState> shared = s.shared;
+        createArena(shared->import.meshes);
+        computeLodBounds(shared->import.meshes);
+        meshes.reserve(shared->import.meshes.size());
+        for (MeshData &data : shared->import.meshes)
+        {
+            for (Texture &texture : data.textures)
+                texture = loadMaterialTexture(texture.path, texture.type);
+            if (residency == MESH_CPU_ONLY)
+                meshes.emplace_back(std::move(data), MESH_CPU_ONLY);
+            else
+            {
+                meshes.emplace_back(data.VertexCount(), data.IndexCount(), data.textures, arena);
+                meshes.back().lods = data.Lods();
+                meshes.back().meshlets = data.meshlets;
+            }
+            meshes.back().glslIdentifierPrefix = glslIdentifierPrefix;
+        }
+        s.started = true;
+        // CPU-only meshes have nothing to stream: no geometry uploads and no textures
+        if (residency == MESH_CPU_ONLY)
+        {
+            s.mesh = meshes.size();
+            return;
+        }
+        for (size_t i = 0; i < textures_loaded.size(); i++)
+        {
+            string fullPath = directory + '/' + textures_loaded[i].path;
+            s.textureKeys.push_back(TextureRegistry::MakeKey(fullPath, 0));
+            textures_loaded[i].id = TextureRegistry::Get().Acquire(s.textureKeys[i]);
+            if (textures_loaded[i].id)
+                continue;
+            ThreadPool::Shared().Submit([i, fullPath, shared] {
+                shared->decoded.Push(std::make_pair(i, TextureSource::Load(fullPath, false)));
+            });
+            s.texturesPending++;
+        }
+    }
+
+    // bounding sphere of the whole model and the error of each level of detail, for selectLod()
+    void computeLodBounds(const vector<MeshData> &data)
+    {
+        glm::vec3 low(std::numeric_limits<float>::max()), high(-std::numeric_limits<float>::max());
+        lodErrors.assign(1, 0.0f);
+        for (const MeshData &mesh : data)
+        {
+            const PackedVertex *vertices = mesh.VertexData();
+            for (size_t i = 0; i < mesh.VertexCount(); i++)
+            {
+                glm::vec3 p(vertices[i].Position[0], vertices[i].Position[1], vertices[i].Position[2]);
+                low = glm::min(low, p);
+                high = glm::max(high, p);
+            }
+            // a mesh with fewer levels draws its coarsest one for the levels it lacks
+            vector<MeshLod> lods = mesh.Lods();
+            if (lods.size() > lodErrors.size())
+                lodErrors.resize(lods.size(), 0.0f);
+            for (size_t level = 0; level < lodErrors.size(); level++)
+                lodErrors[level] = std::max(lodErrors[level], lods[std::min(level, lods.size() - 1)].error);
+        }
+        if (low.x > high.x)
+            return;
+        boundsCenter = (low + high) * 0.5f;
+        boundsRadius = glm::length(high - low) * 0.5f;
+    }
+
+    // the coarsest level whose error projects to less than LodPixelError, moving at most as far from the
+    // current level as the hysteresis band allows
+    unsigned int selectLod(const RenderView &view, const glm::mat4 &transform, unsigned int current) const
+    {
+        if (lodErrors.size() < 2)
+            return 0;
+        float scale = std::max(glm::length(glm::vec3(transform[0])),
+                               std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+        glm::vec3 center = glm::vec3(transform * glm::vec4(boundsCenter, 1.0f));
+        // distance to the nearest point of the bounding sphere; from inside it only full detail will do
+        float distance = glm::length(center - view.cameraPosition) - boundsRadius * scale;
+        if (distance <= 0.0f)
+            return 0;
+        auto pixelError = [&](unsigned int level) { return view.ProjectedSize(lodErrors[level] * scale, distance); };
+        unsigned int level = std::min<unsigned int>(current, lodErrors.size() - 1);
+        while (level > 0 && pixelError(level) > LodPixelError * (1.0f + LodHysteresis))
+            level--;
+        while (level + 1 < lodErrors.size() && pixelError(level + 1) < LodPixelError * (1.0f - LodHysteresis))
+            level++;
+        return level;
+    }
+
+    void drawLevel(Shader &shader, unsigned int lod, const CullView *cull = nullptr)
+    {
+        if (!ready)
+        {
+            drawPlaceholder(shader);
+            return;
+        }
+        if (arena)
+        {
+            // every mesh lives in the arena: one VAO bind for the whole model
+            glBindVertexArray(arena->VAO());
+            for (Mesh &mesh : meshes)
+                mesh.DrawInBoundArena(shader, lod, cull);
+            glBindVertexArray(0);
+            glActiveTexture(GL_TEXTURE0);
+            return;
+        }
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Draw(shader, lod, cull);
+    }
+
+    // picks the arena the meshes are allocated from; a model-owned one is sized to fit them exactly
+    void createArena(const vector<MeshData> &data)
+    {
+        if (residency == MESH_CPU_ONLY)
+        {
+            arena = nullptr;
+            return;
+        }
+        if (arena)
+            return;
+        size_t vertexCount = 0, indexBytes = 0;
+        for (const MeshData &mesh : data)
+        {
+            size_t indexSize = Mesh::IndexTypeFor(mesh.VertexCount()) == GL_UNSIGNED_SHORT ? 2 : 4;
+            vertexCount += mesh.VertexCount();
+            // each range is padded to the arena's index alignment
+            indexBytes += (mesh.IndexCount() * indexSize + BufferArena::IndexAlignment - 1)
+                          / BufferArena::IndexAlignment * BufferArena::IndexAlignment;
+        }
+        ownArena.reset(new BufferArena(vertexCount, indexBytes));
+        arena = ownArena.get();
+    }
+
+    string residencyReport() const
+    {
+        static const char *names[] = { "GPU only", "CPU and GPU", "CPU only" };
+        size_t cpuBytes = 0;
+        for (const Mesh &mesh : meshes)
+            cpuBytes += mesh.CPUBytes();
+        string report = string(names[residency]) + ": " + std::to_string(cpuBytes / 1024) + " KiB of CPU geometry, process RSS "
+                      + std::to_string(ResidentSetBytes() / (1024 * 1024)) + " MiB";
+        if (arena)
+            report += ", " + std::to_string(meshes.size()) + " meshes in " + (ownArena ? "its own" : "a shared")
+                    + " buffer arena (" + arena->Report() + ")";
+        return report;
+    }
+
+    // a small grey cube drawn in place of models that are still streaming in
+    void drawPlaceholder(Shader &shader)
+    {
+        // never freed: a static destructor would run after the GL context is gone
+        static Mesh *placeholder = nullptr;
+        if (!placeholder)
+        {
+            vector<Vertex> vertices;
+            vector<unsigned int> indices;
+            const glm::vec3 normals[6] = {
+                glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+                glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)
+            };
+            for (const glm::vec3 &n : normals)
             {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
+                // two axes spanning the face, chosen so the corners wind counter-clockwise seen from outside
+                glm::vec3 u = std::fabs(n.y) > 0.5f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+                glm::vec3 v = glm::cross(u, n);
+                unsigned int base = vertices.size();
+                const float corners[4][2] = { {-1, -1}, {1, -1}, {1, 1}, {-1, 1} };
+                for (const auto &c : corners)
                 {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
+                    Vertex vertex;
+                    vertex.Position = n + v * c[0] + u * c[1];
+                    vertex.Normal = n;
+                    vertex.TexCoords = glm::vec2(c[0] * 0.5f + 0.5f, c[1] * 0.5f + 0.5f);
+                    vertex.Tangent = v;
+                    vertex.Bitangent = u;
+                    vertices.push_back(vertex);
                 }
+                const unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+                for (unsigned int i : quad)
+                    indices.push_back(base + i);
             }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
+            // flat 1x1 maps: grey diffuse, no specular, straight-up normal, no parallax depth
+            const unsigned char texels[4][3] = { {128, 128, 128}, {0, 0, 0}, {128, 128, 255}, {0, 0, 0} };
+            const char *types[4] = { "texture_diffuse", "texture_specular", "texture_normal", "texture_height" };
+            vector<Texture> textures;
+            for (unsigned int i = 0; i < 4; i++)
+            {
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
+                glGenTextures(1, &texture.id);
+                glBindTexture(GL_TEXTURE_2D, texture.id);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, texels[i]);
+                glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                texture.type = types[i];
                 textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
             }
+            placeholder = new Mesh(vertices, indices, textures);
         }
-        return textures;
+        placeholder->glslIdentifierPrefix = glslIdentifierPrefix;
+        placeholder->Draw(shader);
     }
 };
 
@@ -222,38 +877,6 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return AcquireTexture2D(filename, gamma);
 }
 #endif
@@ -0,0 +1,670 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/tangent_space.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Wavefront OBJ/MTL importer producing the MeshData Model gets from Assimp with its ImportFlags:
+// polygons fanned into triangles, V flipped, smooth normals for meshes without any, and MikkTSpace
+// tangents (tangent_space.h).
+// Like Assimp's OBJ importer, a new mesh starts at every object ("o") or group ("g") and whenever the
+// material changes, and empty meshes are dropped. Unlike it, vertices are shared: every distinct v/vt/vn
+// triple of a mesh becomes one vertex, found through a hash table.
+// The file is memory-mapped and cut into line-aligned chunks that are parsed on all cores of the pool,
+// then every mesh is built on a core of its own.
+namespace ObjLoader {
+
+    // bump whenever the meshes Load() produces change, caches of them (mesh_cache.h) are keyed on it
+    static const uint32_t Version = 1;
+
+    // a whole file mapped read-only
+    class MappedFile
+    {
+    public:
+        MappedFile() : data(nullptr), size(0) {}
+        ~MappedFile()
+        {
+            if (data)
+                munmap(const_cast<char*>(data), size);
+        }
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool Open(const std::string &path)
+        {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0)
+            {
+                close(fd);
+                return false;
+            }
+            size = st.st_size;
+            if (size > 0)
+            {
+                void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped == MAP_FAILED)
+                {
+                    close(fd);
+                    size = 0;
+                    return false;
+                }
+                data = static_cast<const char*>(mapped);
+            }
+            close(fd);
+            return true;
+        }
+
+        const char *Data() const { return data; }
+        size_t Size() const { return size; }
+
+    private:
+        const char *data;
+        size_t size;
+    };
+
+    // chunks smaller than this are not worth a job of their own
+    static const size_t MinChunkBytes = 64 * 1024;
+
+    // index triple of one face corner, 0-based; -1 where the face gives none
+    struct Corner {
+        int32_t v, vt, vn;
+    };
+
+    // a new object or group, a usemtl or an mtllib, before triangle `triangle` (counted over the whole file)
+    struct Event {
+        enum Kind { OBJECT, MATERIAL, LIBRARY } kind;
+        size_t triangle;
+        std::string name;
+    };
+
+    // what one run of lines parsed into
+    struct Chunk {
+        std::vector<float> positions;       // xyz
+        std::vector<float> texCoords;       // uv, v already flipped
+        std::vector<float> normals;         // xyz
+        std::vector<Corner> corners;        // 3 per triangle
+        std::vector<Event> events;          // triangle relative to the chunk until merged
+        // components of corners given as negative (relative) indices; they hold the index relative to the
+        // first element of the chunk until merged
+        std::vector<size_t> relative;       // 3 * corner + component
+    };
+
+    struct Material {
+        std::string diffuse, specular, bump, ambient;   // texture paths as written in the MTL file
+    };
+
+    inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    inline const char *skipSpace(const char *p, const char *end)
+    {
+        while (p < end && isSpace(*p))
+            p++;
+        return p;
+    }
+
+    // the rest of the line without surrounding whitespace
+    inline std::string restOfLine(const char *p, const char *end)
+    {
+        p = skipSpace(p, end);
+        while (end > p && isSpace(end[-1]))
+            end--;
+        return std::string(p, end);
+    }
+
+    inline const char *parseInt(const char *p, const char *end, int &value)
+    {
+        bool negative = false;
+        const char *start = p;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        const char *digits = p;
+        int result = 0;
+        while (p < end && (unsigned)(*p - '0') < 10)
+            result = result * 10 + (*p++ - '0');
+        if (p == digits)
+            return start;
+        value = negative ? -result : result;
+        return p;
+    }
+
+    // Parses [+-]digits[.digits][(e|E)[+-]digits] without strtof's locale handling and the copy its null
+    // terminator would need at the end of the mapping. Digits beyond 17 significant ones are dropped, which
+    // float precision never sees. Anything else (inf, nan) goes to strtof. Returns p if there is no number.
+    inline const char *parseFloat(const char *p, const char *end, float &value)
+    {
+        static const double powersOf10[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                             1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+        const uint64_t maxMantissa = 10000000000000000ull;
+        const char *start = p;
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        bool anyDigits = false;
+        for (; p < end && (unsigned)(*p - '0') < 10; p++, anyDigits = true)
+        {
+            if (mantissa < maxMantissa)
+                mantissa = mantissa * 10 + (*p - '0');
+            else
+                exponent++;
+        }
+        if (p < end && *p == '.')
+        {
+            for (p++; p < end && (unsigned)(*p - '0') < 10; p++, anyDigits = true)
+            {
+                if (mantissa < maxMantissa)
+                {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    exponent--;
+                }
+            }
+        }
+        if (!anyDigits)
+        {
+            char text[32];
+            size_t length = std::min<size_t>(end - start, sizeof(text) - 1);
+            std::memcpy(text, start, length);
+            text[length] = '\0';
+            char *parsed;
+            value = std::strtof(text, &parsed);
+            return start + (parsed - text);
+        }
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            const char *q = p + 1;
+            bool negativeExponent = false;
+            if (q < end && (*q == '-' || *q == '+'))
+                negativeExponent = *q++ == '-';
+            if (q < end && (unsigned)(*q - '0') < 10)
+            {
+                int e = 0;
+                for (; q < end && (unsigned)(*q - '0') < 10; q++)
+                    if (e < 10000)
+                        e = e * 10 + (*q - '0');
+                exponent += negativeExponent ? -e : e;
+                p = q;
+            }
+        }
+        double result = (double)mantissa;
+        if (exponent < 0)
+            result = exponent >= -22 ? result / powersOf10[-exponent] : result / std::pow(10.0, -exponent);
+        else if (exponent > 0)
+            result = exponent <= 22 ? result * powersOf10[exponent] : result * std::pow(10.0, exponent);
+        value = (float)(negative ? -result : result);
+        return p;
+    }
+
+    // up to n floats of a "v", "vt" or "vn" line, missing ones are 0
+    inline void parseFloats(const char *p, const char *end, int n, float *out)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            out[i] = 0.0f;
+            p = skipSpace(p, end);
+            p = parseFloat(p, end, out[i]);
+        }
+    }
+
+    // 1-based index as written in the file to 0-based; negative ones count back from the end of the list
+    // so far and are made relative to the chunk's first element (see Chunk::relative)
+    inline int32_t resolveIndex(int value, size_t countInChunk, Chunk &chunk, size_t component)
+    {
+        if (value > 0)
+            return value - 1;
+        if (value < 0)
+        {
+            chunk.relative.push_back(component);
+            return (int32_t)countInChunk + value;
+        }
+        return -1;
+    }
+
+    inline void parseFace(const char *p, const char *end, Chunk &chunk, std::vector<Corner> &polygon)
+    {
+        polygon.clear();
+        for (;;)
+        {
+            p = skipSpace(p, end);
+            if (p >= end)
+                break;
+            // components get their final position in chunk.corners, which the fan below keeps for corner 0 only,
+            // so relative indices are noted after triangulation
+            Corner corner = { -1, -1, -1 };
+            int value;
+            const char *next = parseInt(p, end, value);
+            if (next == p)
+                break;
+            corner.v = value;
+            p = next;
+            corner.vt = corner.vn = 0;
+            if (p < end && *p == '/')
+            {
+                next = parseInt(++p, end, value);
+                if (next != p)
+                    corner.vt = value;
+                p = next;
+                if (p < end && *p == '/')
+                {
+                    next = parseInt(++p, end, value);
+                    if (next != p)
+                        corner.vn = value;
+                    p = next;
+                }
+            }
+            polygon.push_back(corner);
+            while (p < end && !isSpace(*p))
+                p++;
+        }
+        // fan triangulation, as Assimp does for convex polygons
+        for (size_t i = 2; i < polygon.size(); i++)
+        {
+            const Corner fan[3] = { polygon[0], polygon[i - 1], polygon[i] };
+            for (const Corner &raw : fan)
+            {
+                size_t base = 3 * chunk.corners.size();
+                Corner corner;
+                corner.v = resolveIndex(raw.v, chunk.positions.size() / 3, chunk, base);
+                corner.vt = resolveIndex(raw.vt, chunk.texCoords.size() / 2, chunk, base + 1);
+                corner.vn = resolveIndex(raw.vn, chunk.normals.size() / 3, chunk, base + 2);
+                chunk.corners.push_back(corner);
+            }
+        }
+    }
+
+    inline void parseChunk(const char *begin, const char *end, Chunk &chunk)
+    {
+        std::vector<Corner> polygon;
+        for (const char *p = begin; p < end; )
+        {
+            const char *lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!lineEnd)
+                lineEnd = end;
+            p = skipSpace(p, lineEnd);
+            size_t length = lineEnd - p;
+            if (length >= 2 && p[0] == 'v' && isSpace(p[1]))
+            {
+                float xyz[3];
+                parseFloats(p + 2, lineEnd, 3, xyz);
+                chunk.positions.insert(chunk.positions.end(), xyz, xyz + 3);
+            }
+            else if (length >= 3 && p[0] == 'v' && p[1] == 't' && isSpace(p[2]))
+            {
+                float uv[2];
+                parseFloats(p + 3, lineEnd, 2, uv);
+                // aiProcess_FlipUVs
+                chunk.texCoords.push_back(uv[0]);
+                chunk.texCoords.push_back(1.0f - uv[1]);
+            }
+            else if (length >= 3 && p[0] == 'v' && p[1] == 'n' && isSpace(p[2]))
+            {
+                float xyz[3];
+                parseFloats(p + 3, lineEnd, 3, xyz);
+                chunk.normals.insert(chunk.normals.end(), xyz, xyz + 3);
+            }
+            else if (length >= 2 && p[0] == 'f' && isSpace(p[1]))
+            {
+                parseFace(p + 2, lineEnd, chunk, polygon);
+            }
+            else if (length >= 2 && (p[0] == 'o' || p[0] == 'g') && isSpace(p[1]))
+            {
+                chunk.events.push_back(Event{Event::OBJECT, chunk.corners.size() / 3, restOfLine(p + 2, lineEnd)});
+            }
+            else if (length >= 7 && std::strncmp(p, "usemtl", 6) == 0 && isSpace(p[6]))
+            {
+                chunk.events.push_back(Event{Event::MATERIAL, chunk.corners.size() / 3, restOfLine(p + 7, lineEnd)});
+            }
+            else if (length >= 7 && std::strncmp(p, "mtllib", 6) == 0 && isSpace(p[6]))
+            {
+                chunk.events.push_back(Event{Event::LIBRARY, chunk.corners.size() / 3, restOfLine(p + 7, lineEnd)});
+            }
+            p = lineEnd + 1;
+        }
+    }
+
+    // the file name of a map_* statement, skipping options like "-bm 0.5" in front of it
+    inline std::string texturePath(const std::string &statement)
+    {
+        static const std::map<std::string, int> optionArguments = {
+            {"-bm", 1}, {"-blendu", 1}, {"-blendv", 1}, {"-boost", 1}, {"-cc", 1}, {"-clamp", 1},
+            {"-imfchan", 1}, {"-mm", 2}, {"-o", 3}, {"-s", 3}, {"-t", 3}, {"-texres", 1}, {"-type", 1}
+        };
+        const char *p = statement.c_str(), *end = p + statement.size();
+        for (;;)
+        {
+            p = skipSpace(p, end);
+            if (p >= end || *p != '-')
+                break;
+            const char *nameEnd = p;
+            while (nameEnd < end && !isSpace(*nameEnd))
+                nameEnd++;
+            auto option = optionArguments.find(std::string(p, nameEnd));
+            if (option == optionArguments.end())
+                break;
+            p = nameEnd;
+            // -o, -s and -t take one to three numbers
+            for (int i = 0; i < option->second; i++)
+            {
+                const char *argument = skipSpace(p, end);
+                float number;
+                if (option->second == 3 && parseFloat(argument, end, number) == argument)
+                    break;
+                p = argument;
+                while (p < end && !isSpace(*p))
+                    p++;
+            }
+        }
+        return restOfLine(p, end);
+    }
+
+    inline void loadMaterials(const std::string &path, std::map<std::string, Material> &materials)
+    {
+        std::ifstream in(path);
+        if (!in)
+        {
+            std::cout << "ObjLoader: material library " << path << " not found" << std::endl;
+            return;
+        }
+        Material *current = nullptr;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            const char *p = skipSpace(line.c_str(), line.c_str() + line.size()), *end = line.c_str() + line.size();
+            const char *keywordEnd = p;
+            while (keywordEnd < end && !isSpace(*keywordEnd))
+                keywordEnd++;
+            std::string keyword(p, keywordEnd);
+            std::string rest = restOfLine(keywordEnd, end);
+            if (keyword == "newmtl")
+                current = &materials[rest];
+            else if (!current)
+                continue;
+            else if (keyword == "map_Kd")
+                current->diffuse = texturePath(rest);
+            else if (keyword == "map_Ks")
+                current->specular = texturePath(rest);
+            else if (keyword == "map_Bump" || keyword == "map_bump" || keyword == "bump")
+                current->bump = texturePath(rest);
+            else if (keyword == "map_Ka")
+                current->ambient = texturePath(rest);
+        }
+    }
+
+    // in the order Model::processMesh lists a material's textures
+    inline std::vector<Texture> materialTextures(const Material &material)
+    {
+        std::vector<Texture> textures;
+        const std::pair<const std::string*, const char*> maps[] = {
+            {&material.diffuse, "texture_diffuse"},
+            {&material.specular, "texture_specular"},
+            {&material.bump, "texture_normal"},      // Assimp reads bump maps as aiTextureType_HEIGHT
+            {&material.ambient, "texture_height"}    // and ambient maps as aiTextureType_AMBIENT
+        };
+        for (const auto &map : maps)
+            if (!map.first->empty())
+                textures.push_back(Texture{0, map.second, *map.first});
+        return textures;
+    }
+
+    // triangles [first, first + count) of the file as one mesh
+    struct MeshRange {
+        size_t first;
+        size_t count;
+        std::string material;
+    };
+
+    struct ParsedFile {
+        std::vector<float> positions, texCoords, normals;
+        std::vector<Corner> corners;
+    };
+
+    inline size_t hashCorner(const Corner &c)
+    {
+        uint64_t h = (uint64_t)(uint32_t)c.v * 0x9E3779B97F4A7C15ull;
+        h ^= ((uint64_t)(uint32_t)c.vt + 0x632BE59BD9B4E019ull) * 0xBF58476D1CE4E5B9ull;
+        h ^= ((uint64_t)(uint32_t)c.vn + 0x8CB92BA72F3D8DD7ull) * 0x94D049BB133111EBull;
+        return (size_t)(h ^ (h >> 31));
+    }
+
+    inline MeshData buildMesh(const ParsedFile &file, const MeshRange &range, const std::vector<Texture> &textures)
+    {
+        MeshData data;
+        data.textures = textures;
+        int32_t positionCount = file.positions.size() / 3;
+        int32_t texCoordCount = file.texCoords.size() / 2;
+        int32_t normalCount = file.normals.size() / 3;
+
+        // open addressing table of vertex index + 1, 0 for an empty slot
+        size_t tableSize = 16;
+        while (tableSize < 2 * 3 * range.count)
+            tableSize *= 2;
+        std::vector<uint32_t> table(tableSize, 0);
+        std::vector<Corner> unique;
+        bool hasNormals = false;
+        data.indices.reserve(3 * range.count);
+        for (size_t t = range.first; t < range.first + range.count; t++)
+        {
+            const Corner *triangle = &file.corners[3 * t];
+            if (triangle[0].v < 0 || triangle[0].v >= positionCount || triangle[1].v < 0 || triangle[1].v >= positionCount
+                    || triangle[2].v < 0 || triangle[2].v >= positionCount)
+                continue;
+            for (int k = 0; k < 3; k++)
+            {
+                Corner corner = triangle[k];
+                if (corner.vt >= texCoordCount)
+                    corner.vt = -1;
+                if (corner.vn >= normalCount)
+                    corner.vn = -1;
+                size_t slot = hashCorner(corner) & (tableSize - 1);
+                while (table[slot])
+                {
+                    const Corner &existing = unique[table[slot] - 1];
+                    if (existing.v == corner.v && existing.vt == corner.vt && existing.vn == corner.vn)
+                        break;
+                    slot = (slot + 1) & (tableSize - 1);
+                }
+                if (!table[slot])
+                {
+                    unique.push_back(corner);
+                    table[slot] = unique.size();
+                }
+                data.indices.push_back(table[slot] - 1);
+                hasNormals = hasNormals || corner.vn >= 0;
+            }
+        }
+
+        std::vector<Vertex> &vertices = data.vertices;
+        vertices.resize(unique.size());
+        for (size_t i = 0; i < unique.size(); i++)
+        {
+            const Corner &c = unique[i];
+            Vertex &vertex = vertices[i];
+            vertex.Position = glm::vec3(file.positions[3 * c.v], file.positions[3 * c.v + 1], file.positions[3 * c.v + 2]);
+            vertex.Normal = c.vn >= 0 ? glm::vec3(file.normals[3 * c.vn], file.normals[3 * c.vn + 1], file.normals[3 * c.vn + 2])
+                                      : glm::vec3(0.0f);
+            vertex.TexCoords = c.vt >= 0 ? glm::vec2(file.texCoords[2 * c.vt], file.texCoords[2 * c.vt + 1]) : glm::vec2(0.0f);
+            vertex.Tangent = glm::vec3(0.0f);
+            vertex.Bitangent = glm::vec3(0.0f);
+        }
+
+        // aiProcess_GenSmoothNormals: the average of the facing of the triangles around each position
+        if (!hasNormals)
+        {
+            std::unordered_map<int32_t, glm::vec3> byPosition;
+            for (size_t i = 0; i + 2 < data.indices.size(); i += 3)
+            {
+                const Vertex &a = vertices[data.indices[i]], &b = vertices[data.indices[i + 1]], &c = vertices[data.indices[i + 2]];
+                glm::vec3 n = glm::cross(b.Position - a.Position, c.Position - a.Position);
+                float length = glm::length(n);
+                if (length == 0.0f)
+                    continue;
+                for (int k = 0; k < 3; k++)
+                    byPosition[unique[data.indices[i + k]].v] += n / length;
+            }
+            for (size_t i = 0; i < vertices.size(); i++)
+            {
+                glm::vec3 n = byPosition[unique[i].v];
+                float length = glm::length(n);
+                vertices[i].Normal = length > 0.0f ? n / length : glm::vec3(0.0f);
+            }
+        }
+
+        TangentSpace::Generate(data);
+        return data;
+    }
+
+    inline bool IsObjFile(const std::string &path)
+    {
+        size_t dot = path.find_last_of('.');
+        if (dot == std::string::npos)
+            return false;
+        std::string extension = path.substr(dot + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        return extension == "obj";
+    }
+
+    // paths of the MTL files the OBJ file at path names in its mtllib statements
+    inline std::vector<std::string> MaterialLibraries(const std::string &path)
+    {
+        std::vector<std::string> libraries;
+        MappedFile file;
+        if (!file.Open(path))
+            return libraries;
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+        const char *p = file.Data(), *end = p + file.Size();
+        while (p < end)
+        {
+            const char *lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!lineEnd)
+                lineEnd = end;
+            p = skipSpace(p, lineEnd);
+            if (lineEnd - p >= 7 && std::strncmp(p, "mtllib", 6) == 0 && isSpace(p[6]))
+                libraries.push_back(directory + restOfLine(p + 7, lineEnd));
+            p = lineEnd + 1;
+        }
+        return libraries;
+    }
+
+    // imports the OBJ file at path and its materials into meshes; false if the file cannot be read.
+    // Safe on any thread, including the pool's own workers.
+    inline bool Load(const std::string &path, std::vector<MeshData> &meshes, ThreadPool &pool = ThreadPool::Shared())
+    {
+        MappedFile file;
+        if (!file.Open(path))
+        {
+            std::cout << "ObjLoader: could not open " << path << std::endl;
+            return false;
+        }
+
+        // line-aligned chunks, a few per thread so uneven ones even out
+        const char *begin = file.Data(), *end = begin + file.Size();
+        size_t chunkCount = std::max<size_t>(1, std::min<size_t>(file.Size() / MinChunkBytes, 4 * (pool.Size() + 1)));
+        std::vector<const char*> bounds(chunkCount + 1, end);
+        bounds[0] = begin;
+        for (size_t i = 1; i < chunkCount; i++)
+        {
+            const char *p = std::max(bounds[i - 1], begin + file.Size() * i / chunkCount);
+            const char *lineEnd = p < end ? static_cast<const char*>(std::memchr(p, '\n', end - p)) : nullptr;
+            bounds[i] = lineEnd ? lineEnd + 1 : end;
+        }
+        std::vector<Chunk> chunks(chunkCount);
+        pool.ParallelFor(chunkCount, [&](size_t i) { parseChunk(bounds[i], bounds[i + 1], chunks[i]); });
+
+        // where each chunk's elements go in the whole file
+        std::vector<size_t> positionStart(chunkCount + 1, 0), texCoordStart(chunkCount + 1, 0);
+        std::vector<size_t> normalStart(chunkCount + 1, 0), cornerStart(chunkCount + 1, 0);
+        for (size_t i = 0; i < chunkCount; i++)
+        {
+            positionStart[i + 1] = positionStart[i] + chunks[i].positions.size();
+            texCoordStart[i + 1] = texCoordStart[i] + chunks[i].texCoords.size();
+            normalStart[i + 1] = normalStart[i] + chunks[i].normals.size();
+            cornerStart[i + 1] = cornerStart[i] + chunks[i].corners.size();
+        }
+        ParsedFile parsed;
+        parsed.positions.resize(positionStart[chunkCount]);
+        parsed.texCoords.resize(texCoordStart[chunkCount]);
+        parsed.normals.resize(normalStart[chunkCount]);
+        parsed.corners.resize(cornerStart[chunkCount]);
+        pool.ParallelFor(chunkCount, [&](size_t i) {
+            Chunk &chunk = chunks[i];
+            const size_t firsts[3] = { positionStart[i] / 3, texCoordStart[i] / 2, normalStart[i] / 3 };
+            for (size_t component : chunk.relative)
+            {
+                int32_t &index = (&chunk.corners[component / 3].v)[component % 3];
+                index = index + (int64_t)firsts[component % 3] >= 0 ? (int32_t)(index + firsts[component % 3]) : -1;
+            }
+            std::copy(chunk.positions.begin(), chunk.positions.end(), parsed.positions.begin() + positionStart[i]);
+            std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), parsed.texCoords.begin() + texCoordStart[i]);
+            std::copy(chunk.normals.begin(), chunk.normals.end(), parsed.normals.begin() + normalStart[i]);
+            std::copy(chunk.corners.begin(), chunk.corners.end(), parsed.corners.begin() + cornerStart[i]);
+            std::vector<float>().swap(chunk.positions);
+            std::vector<float>().swap(chunk.texCoords);
+            std::vector<float>().swap(chunk.normals);
+            std::vector<Corner>().swap(chunk.corners);
+        });
+
+        // split the triangles into meshes
+        std::string directory = path.substr(0, path.find_last_of('/') + 1);
+        std::map<std::string, Material> materials;
+        std::vector<MeshRange> ranges;
+        std::string material;
+        size_t rangeStart = 0;
+        for (size_t i = 0; i < chunkCount; i++)
+        {
+            for (const Event &event : chunks[i].events)
+            {
+                size_t triangle = cornerStart[i] / 3 + event.triangle;
+                if (event.kind == Event::LIBRARY)
+                {
+                    loadMaterials(directory + event.name, materials);
+                    continue;
+                }
+                if (event.kind == Event::MATERIAL && event.name == material)
+                    continue;
+                if (triangle > rangeStart)
+                    ranges.push_back(MeshRange{rangeStart, triangle - rangeStart, material});
+                rangeStart = triangle;
+                if (event.kind == Event::MATERIAL)
+                    material = event.name;
+            }
+        }
+        if (parsed.corners.size() / 3 > rangeStart)
+            ranges.push_back(MeshRange{rangeStart, parsed.corners.size() / 3 - rangeStart, material});
+
+        std::vector<MeshData> built(ranges.size());
+        pool.ParallelFor(ranges.size(), [&](size_t i) {
+            auto it = materials.find(ranges[i].material);
+            built[i] = buildMesh(parsed, ranges[i], it != materials.end() ? materialTextures(it->second) : std::vector<Texture>());
+        });
+        for (MeshData &data : built)
+            if (!data.indices.empty())
+                meshes.push_back(std::move(data));
+        return true;
+    }
+}
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef PACKED_VERTEX_H
+#define PACKED_VERTEX_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// GPU vertex layout of a Mesh, 24 bytes instead of the 56 of the float Vertex it is packed from:
+//
+//   Position   3 x float32
+//   Normal     signed normalized 10:10:10:2 (GL_INT_2_10_10_10_REV), w unused
+//   Tangent    signed normalized 10:10:10:2, w holds the handedness of the bitangent (+1 or -1)
+//   TexCoords  2 x float16
+//
+// The bitangent is not stored: the vertex shader rebuilds it as cross(normal, tangent) * handedness.
+struct PackedVertex {
+    float    Position[3];
+    uint32_t Normal;
+    uint32_t Tangent;
+    uint16_t TexCoords[2];
+};
+
+static_assert(sizeof(PackedVertex) == 24, "PackedVertex must stay tightly packed");
+
+// IEEE 754 binary16 with round-to-nearest-even, overflow goes to infinity
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = (int32_t)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF)
+        return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+    if (exponent >= 31)
+        return sign | 0x7C00;
+    if (exponent <= 0)
+    {
+        // subnormal half, or zero when even that is too small
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return sign | half;
+    }
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    // a carry out of the mantissa correctly bumps the exponent
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return half;
+}
+
+inline float HalfToFloat(uint16_t half)
+{
+    uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    float value;
+    if (exponent == 0)
+        value = std::ldexp((float)mantissa, -24);
+    else if (exponent == 31)
+        value = mantissa ? NAN : INFINITY;
+    else
+        value = std::ldexp((float)(mantissa | 0x400), (int)exponent - 25);
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    bits |= sign;
+    std::memcpy(&value, &bits, sizeof(bits));
+    return value;
+}
+
+// signed normalized 10:10:10:2 in GL_INT_2_10_10_10_REV order (x in the low bits)
+inline uint32_t PackSnorm1010102(const glm::vec3 &v, float w)
+{
+    auto snorm = [](float c, float scale, uint32_t mask) {
+        return (uint32_t)(int32_t)std::lround(std::min(1.0f, std::max(-1.0f, c)) * scale) & mask;
+    };
+    return snorm(v.x, 511.0f, 0x3FF) | (snorm(v.y, 511.0f, 0x3FF) << 10) | (snorm(v.z, 511.0f, 0x3FF) << 20)
+         | (snorm(w, 1.0f, 0x3) << 30);
+}
+
+inline glm::vec3 UnpackSnorm1010102(uint32_t packed, float *w = nullptr)
+{
+    // sign-extend each field
+    auto field = [packed](int shift, int bits) {
+        int32_t value = (int32_t)(packed << (32 - shift - bits)) >> (32 - bits);
+        return std::max(-1.0f, value / (float)((1 << (bits - 1)) - 1));
+    };
+    if (w)
+        *w = field(30, 2);
+    return glm::vec3(field(0, 10), field(10, 10), field(20, 10));
+}
+
+inline glm::vec3 NormalizeOrZero(const glm::vec3 &v)
+{
+    float length = glm::length(v);
+    return length > 0.0f ? v / length : v;
+}
+
+#endif
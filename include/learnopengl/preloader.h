@@ -0,0 +1,496 @@
+#ifndef PRELOADER_H
+#define PRELOADER_H
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/model.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
+#include <learnopengl/stopwatch.h>
+#include <learnopengl/texture.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum AssetType {
+    ASSET_SHADER,
+    ASSET_TEXTURE,
+    ASSET_CUBEMAP,
+    ASSET_MODEL,
+    ASSET_TEXTURE_ARRAY
+};
+
+// one line of an AssetManifest
+struct AssetEntry {
+    AssetType type;
+    std::string name;
+    int priority = 0;           // lower uploads first among the assets that are ready
+    bool srgb = false;          // textures: colour data, sampled as sRGB
+    std::vector<ShaderDefines> variants;    // shaders: the variants compiled at startup, the first is the default
+    std::vector<std::string> paths;
+};
+
+// The assets a scene needs, read from a text file with one asset per line:
+//
+//   <type> <name> <priority> <flags> <path>...
+//
+// type is shader (vertex, fragment and optionally geometry shader paths), texture, cubemap (six faces in
+// the order +X, -X, +Y, -Y, +Z, -Z), array (a 2D texture array, one layer per path) or model. flags is a
+// comma separated list, "-" for none: srgb for textures, NAME=value for the defines of the shader variant
+// compiled at startup. A shader compiled in several variants at startup lists each one's defines, separated
+// by '|'; the first is the one GetShader() returns. Paths are relative to the repository root, '#' starts
+// a comment.
+class AssetManifest
+{
+public:
+    std::vector<AssetEntry> entries;
+
+    // returns false if the file cannot be read; malformed lines are reported and skipped
+    bool LoadFromFile(const std::string &filename)
+    {
+        std::ifstream in(filename);
+        if (!in)
+        {
+            std::cout << "Manifest " << filename << " not found" << std::endl;
+            return false;
+        }
+        std::string line;
+        for (int lineNumber = 1; std::getline(in, line); lineNumber++)
+        {
+            line = line.substr(0, line.find('#'));
+            std::istringstream fields(line);
+            std::string type, flags;
+            AssetEntry entry;
+            if (!(fields >> type))
+                continue;
+            if (!(fields >> entry.name >> entry.priority >> flags) || !parseType(type, entry.type))
+            {
+                std::cout << filename << ":" << lineNumber << ": expected <type> <name> <priority> <flags> <path>..." << std::endl;
+                continue;
+            }
+            for (std::string path; fields >> path; )
+                entry.paths.push_back(path);
+            std::istringstream variantList(flags);
+            for (std::string variant; std::getline(variantList, variant, '|'); )
+            {
+                entry.variants.emplace_back();
+                std::istringstream flagList(variant);
+                for (std::string flag; std::getline(flagList, flag, ','); )
+                {
+                    size_t equals = flag.find('=');
+                    if (flag == "srgb")
+                        entry.srgb = true;
+                    else if (equals != std::string::npos && entry.type == ASSET_SHADER)
+                        entry.variants.back().Set(flag.substr(0, equals), std::atoi(flag.c_str() + equals + 1));
+                    else if (flag != "-")
+                        std::cout << filename << ":" << lineNumber << ": unknown flag " << flag << std::endl;
+                }
+            }
+            size_t minPaths = 1, maxPaths = 1;
+            if (entry.type == ASSET_SHADER)
+                minPaths = 2, maxPaths = 3;
+            else if (entry.type == ASSET_CUBEMAP)
+                minPaths = maxPaths = 6;
+            else if (entry.type == ASSET_TEXTURE_ARRAY)
+                maxPaths = SIZE_MAX;
+            if (entry.paths.size() < minPaths || entry.paths.size() > maxPaths)
+            {
+                std::cout << filename << ":" << lineNumber << ": wrong number of paths for " << type << " " << entry.name << std::endl;
+                continue;
+            }
+            entries.push_back(entry);
+        }
+        return true;
+    }
+
+    static const char *TypeName(AssetType type)
+    {
+        static const char *names[] = { "shader", "texture", "cubemap", "model", "array" };
+        return names[type];
+    }
+
+private:
+    static bool parseType(const std::string &name, AssetType &type)
+    {
+        for (int i = ASSET_SHADER; i <= ASSET_TEXTURE_ARRAY; i++)
+        {
+            if (name == TypeName((AssetType)i))
+            {
+                type = (AssetType)i;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// What the Preloader loaded, by manifest name. Textures, cubemaps and texture arrays hold one
+// TextureRegistry reference each for the rest of the run. GL thread only.
+class AssetSet
+{
+public:
+    // the variant of the shader the manifest names; an asset missing from the manifest is reported and
+    // replaced by an empty program
+    Shader &GetShader(const std::string &name)
+    {
+        return GetVariants(name).Default();
+    }
+
+    // every variant of a shader, for picking one by the current settings
+    ShaderVariants &GetVariants(const std::string &name)
+    {
+        std::unique_ptr<ShaderVariants> &shader = shaders[name];
+        if (!shader)
+        {
+            std::cout << "Asset " << name << " is not a shader in the manifest" << std::endl;
+            shader.reset(new ShaderVariants(Shader::Sources(), ShaderDefines()));
+        }
+        return *shader;
+    }
+
+    // texture, cubemap or texture array; 0 if the manifest has none of that name
+    unsigned int GetTexture(const std::string &name) const
+    {
+        auto it = textures.find(name);
+        if (it == textures.end())
+        {
+            std::cout << "Asset " << name << " is not a texture in the manifest" << std::endl;
+            return 0;
+        }
+        return it->second;
+    }
+
+    // hands the model over to the caller; null if the manifest has none of that name
+    std::unique_ptr<Model> TakeModel(const std::string &name)
+    {
+        std::unique_ptr<Model> model = std::move(models[name]);
+        if (!model)
+            std::cout << "Asset " << name << " is not a model in the manifest" << std::endl;
+        return model;
+    }
+
+private:
+    friend class Preloader;
+    std::map<std::string, std::unique_ptr<ShaderVariants>> shaders;
+    std::map<std::string, unsigned int> textures;
+    std::map<std::string, std::unique_ptr<Model>> models;
+};
+
+// Loads every asset of a manifest at startup. File reads, image decoding (with CPU mips) and mesh import
+// and processing run on the shared thread pool, all submitted at once in priority order; the calling (GL)
+// thread compiles and uploads whatever has finished, lowest priority value first, and streams models in
+// while it waits for the rest. Prints a per-asset timeline so the critical path of the startup shows.
+class Preloader
+{
+public:
+    // bytes of model geometry and textures uploaded per wait for outstanding CPU work
+    static const size_t ModelBudgetPerWait = 1 << 20;
+
+    // returns once every shader, texture and cubemap is on the GPU. Models that are not done by then keep
+    // streaming in through Model::StreamPending() like any LoadAsync() model, drawing a placeholder.
+    static AssetSet Load(const AssetManifest &manifest)
+    {
+        Stopwatch clock;
+        const std::vector<AssetEntry> &entries = manifest.entries;
+        AssetSet set;
+        std::vector<Pending> pending(entries.size());
+        // shared with the jobs: a worker may still be inside Push() when Load() pops the last result
+        std::shared_ptr<CompletionQueue<JobResult>> finished = std::make_shared<CompletionQueue<JobResult>>();
+        std::priority_queue<std::pair<int, size_t>, std::vector<std::pair<int, size_t>>, std::greater<std::pair<int, size_t>>> ready;
+        size_t uploadsLeft = 0;
+
+        // the most urgent CPU work goes to the pool first
+        std::vector<size_t> order(entries.size());
+        for (size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&entries](size_t a, size_t b) { return entries[a].priority < entries[b].priority; });
+        for (size_t i : order)
+        {
+            const AssetEntry &entry = entries[i];
+            Pending &asset = pending[i];
+            asset.timing.queued = clock.ElapsedMs();
+            std::vector<std::string> paths;
+            for (const std::string &path : entry.paths)
+                paths.push_back(FileSystem::getPath(path));
+            if (entry.type == ASSET_MODEL)
+            {
+                set.models[entry.name] = Model::LoadAsync(paths[0]);
+                continue;
+            }
+            if (entry.type == ASSET_SHADER)
+            {
+                submit(finished, clock, i, 0, [paths](JobResult &result) {
+                    result.shader = Shader::ReadSources(paths[0].c_str(), paths[1].c_str(), paths.size() > 2 ? paths[2].c_str() : nullptr);
+                });
+                asset.jobsLeft = 1;
+            }
+            else
+            {
+                // textures already registered by someone else are reused as they are
+                if (entry.type == ASSET_CUBEMAP)
+                    asset.key = CubemapKey(paths);
+                else if (entry.type == ASSET_TEXTURE_ARRAY)
+                    asset.key = TextureArrayKey(paths, entry.srgb);
+                else
+                    asset.key = TextureRegistry::MakeKey(paths[0], entry.srgb ? TEXTURE_SRGB : 0);
+                unsigned int textureID = TextureRegistry::Get().Acquire(asset.key);
+                if (textureID)
+                {
+                    set.textures[entry.name] = textureID;
+                    asset.timing.uploadStart = asset.timing.uploadEnd = clock.ElapsedMs();
+                    continue;
+                }
+                asset.faces = paths;
+                if (entry.type == ASSET_CUBEMAP)
+                    CubemapFiles(paths, asset.files, asset.fileOfFace);
+                else
+                    asset.files = paths;
+                asset.sources.resize(asset.files.size());
+                bool srgb = entry.srgb;
+                // array layers must share a format, cooked files are not used for them
+                bool decode = entry.type == ASSET_TEXTURE_ARRAY;
+                for (size_t part = 0; part < asset.files.size(); part++)
+                {
+                    std::string path = asset.files[part];
+                    submit(finished, clock, i, part, [path, srgb, decode](JobResult &result) {
+                        result.texture = decode ? TextureSource::LoadImage(path, srgb) : TextureSource::Load(path, srgb);
+                    });
+                }
+                asset.jobsLeft = asset.files.size();
+            }
+            uploadsLeft++;
+        }
+
+        while (uploadsLeft > 0)
+        {
+            JobResult result;
+            // block only when there is nothing else to do
+            if (ready.empty() && !modelsStreaming(set))
+                collect(finished->Pop(), entries, pending, ready);
+            while (finished->TryPop(result))
+                collect(std::move(result), entries, pending, ready);
+            if (ready.empty())
+            {
+                Model::StreamPending(ModelBudgetPerWait);
+                finalizeShaders(set);
+                recordModels(set, entries, pending, clock);
+                if (finished->TryPop(result))
+                    collect(std::move(result), entries, pending, ready);
+                else
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+
+            size_t i = ready.top().second;
+            ready.pop();
+            const AssetEntry &entry = entries[i];
+            Pending &asset = pending[i];
+            asset.timing.uploadStart = clock.ElapsedMs();
+            if (entry.type == ASSET_SHADER)
+            {
+                set.shaders[entry.name].reset(new ShaderVariants(asset.shader, entry.variants));
+            }
+            else if (entry.type == ASSET_CUBEMAP)
+            {
+                set.textures[entry.name] = UploadCubemap(asset.faces, asset.files, asset.fileOfFace, asset.sources);
+            }
+            else if (entry.type == ASSET_TEXTURE_ARRAY)
+            {
+                set.textures[entry.name] = UploadTextureArray(asset.files, asset.sources, entry.srgb);
+            }
+            else
+            {
+                unsigned int textureID;
+                if (asset.sources[0].IsValid())
+                {
+                    textureID = UploadTexture2D(asset.sources[0], entry.srgb);
+                }
+                else
+                {
+                    std::cout << "Texture failed to load at path: " << asset.files[0] << std::endl;
+                    glGenTextures(1, &textureID);
+                }
+                TextureRegistry::Get().Insert(asset.key, textureID);
+                set.textures[entry.name] = textureID;
+            }
+            // the decoded data is not needed any more
+            asset.sources.clear();
+            asset.shader = Shader::Sources();
+            asset.timing.uploadEnd = clock.ElapsedMs();
+            uploadsLeft--;
+        }
+        recordModels(set, entries, pending, clock);
+        printTimeline(entries, pending, clock.ElapsedMs());
+        printShaders(entries, pending, set);
+        return set;
+    }
+
+private:
+    // milliseconds since the start of Load(), negative while it has not happened
+    struct Timing {
+        double queued = -1.0;
+        double cpuStart = -1.0;     // first job of the asset
+        double cpuEnd = -1.0;       // last job of the asset
+        double uploadStart = -1.0;
+        double uploadEnd = -1.0;
+    };
+
+    struct Pending {
+        Timing timing;
+        size_t jobsLeft = 0;
+        std::string key;                    // registry key of textures and cubemaps
+        std::vector<std::string> faces;     // cubemap faces, array layers or the texture's path
+        std::vector<std::string> files;     // distinct files among them, one job each
+        std::vector<size_t> fileOfFace;
+        std::vector<TextureSource> sources; // per file
+        Shader::Sources shader;
+    };
+
+    struct JobResult {
+        size_t asset = 0;
+        size_t part = 0;
+        double start = 0.0, end = 0.0;
+        TextureSource texture;
+        Shader::Sources shader;
+    };
+
+    template<typename Work>
+    static void submit(const std::shared_ptr<CompletionQueue<JobResult>> &finished, const Stopwatch &clock, size_t asset,
+                       size_t part, Work work)
+    {
+        // the job keeps its own copy of the clock and a reference to the queue, both outlive Load()
+        ThreadPool::Shared().Submit([finished, clock, asset, part, work] {
+            JobResult result;
+            result.asset = asset;
+            result.part = part;
+            result.start = clock.ElapsedMs();
+            work(result);
+            result.end = clock.ElapsedMs();
+            finished->Push(std::move(result));
+        });
+    }
+
+    template<typename ReadyQueue>
+    static void collect(JobResult result, const std::vector<AssetEntry> &entries, std::vector<Pending> &pending, ReadyQueue &ready)
+    {
+        Pending &asset = pending[result.asset];
+        if (asset.timing.cpuStart < 0.0 || result.start < asset.timing.cpuStart)
+            asset.timing.cpuStart = result.start;
+        asset.timing.cpuEnd = std::max(asset.timing.cpuEnd, result.end);
+        if (entries[result.asset].type == ASSET_SHADER)
+            asset.shader = std::move(result.shader);
+        else
+            asset.sources[result.part] = std::move(result.texture);
+        if (--asset.jobsLeft == 0)
+            ready.push(std::make_pair(entries[result.asset].priority, result.asset));
+    }
+
+    static bool modelsStreaming(const AssetSet &set)
+    {
+        for (const auto &model : set.models)
+            if (model.second && !model.second->IsReady())
+                return true;
+        return false;
+    }
+
+    // checks the programs the driver has finished compiling in the background, so their first use does
+    // not have to
+    static void finalizeShaders(const AssetSet &set)
+    {
+        for (const auto &shader : set.shaders)
+            if (shader.second)
+                shader.second->FinalizeReady();
+    }
+
+    // models are imported and uploaded by Model itself, only the moment they are ready shows here
+    static void recordModels(const AssetSet &set, const std::vector<AssetEntry> &entries, std::vector<Pending> &pending,
+                             const Stopwatch &clock)
+    {
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            if (entries[i].type != ASSET_MODEL || pending[i].timing.uploadEnd >= 0.0)
+                continue;
+            auto it = set.models.find(entries[i].name);
+            if (it != set.models.end() && it->second && it->second->IsReady())
+                pending[i].timing.uploadEnd = clock.ElapsedMs();
+        }
+    }
+
+    static void printTimeline(const std::vector<AssetEntry> &entries, const std::vector<Pending> &pending, double totalMs)
+    {
+        std::cout << "Preload timeline (ms since start):" << std::endl;
+        std::cout << "  type     name                 prio   queued   cpu start  cpu end  upload start  upload end" << std::endl;
+        size_t critical = entries.size();
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            const Timing &t = pending[i].timing;
+            char line[160];
+            std::snprintf(line, sizeof(line), "  %-8s %-20s %4d %8.1f  %9s %8s  %12s  %10s",
+                          AssetManifest::TypeName(entries[i].type), entries[i].name.c_str(), entries[i].priority,
+                          t.queued, format(t.cpuStart).c_str(), format(t.cpuEnd).c_str(),
+                          format(t.uploadStart).c_str(), entries[i].type == ASSET_MODEL && t.uploadEnd < 0.0 ? "streaming" : format(t.uploadEnd).c_str());
+            std::cout << line << std::endl;
+            if (t.uploadEnd >= 0.0 && (critical == entries.size() || t.uploadEnd > pending[critical].timing.uploadEnd))
+                critical = i;
+        }
+        std::cout << "Preload: " << entries.size() << " assets in " << totalMs << " ms on " << ThreadPool::Shared().Size() << " threads";
+        if (critical < entries.size())
+        {
+            // the last asset to finish, split into CPU work, waiting for the GL thread and uploading
+            const Timing &t = pending[critical].timing;
+            std::cout << ", critical path: " << AssetManifest::TypeName(entries[critical].type) << " " << entries[critical].name;
+            if (t.cpuEnd >= 0.0)
+                std::cout << " (CPU " << t.cpuEnd - t.cpuStart << " ms, waited " << t.uploadStart - t.cpuEnd
+                          << " ms for the GL thread, upload " << t.uploadEnd - t.uploadStart << " ms)";
+        }
+        std::cout << std::endl;
+    }
+
+    // how long the GL thread spent on each program: cold ones were submitted for compiling (the driver
+    // may still be busy with them, see Shader::Finalize()), warm ones linked from the ProgramCache
+    static void printShaders(const std::vector<AssetEntry> &entries, const std::vector<Pending> &pending, const AssetSet &set)
+    {
+        double coldMs = 0.0, warmMs = 0.0;
+        int cold = 0, warm = 0;
+        std::cout << "Shader programs (cold: compiled from source, warm: program binary cache" << (ProgramCache::Enabled() ? "" : " not supported") << "):" << std::endl;
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            auto it = set.shaders.find(entries[i].name);
+            if (entries[i].type != ASSET_SHADER || it == set.shaders.end() || !it->second)
+                continue;
+            const Timing &t = pending[i].timing;
+            double ms = t.uploadEnd - t.uploadStart;
+            bool fromCache = it->second->Default().FromCache();
+            char line[96];
+            std::snprintf(line, sizeof(line), "  %-20s %8.1f ms  %s", entries[i].name.c_str(), ms, fromCache ? "warm" : "cold");
+            std::cout << line << std::endl;
+            (fromCache ? warmMs : coldMs) += ms;
+            (fromCache ? warm : cold)++;
+        }
+        std::cout << "Shaders: " << cold << " cold in " << format(coldMs) << " ms, " << warm << " warm in " << format(warmMs) << " ms" << std::endl;
+    }
+
+    static std::string format(double ms)
+    {
+        if (ms < 0.0)
+            return "-";
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.1f", ms);
+        return text;
+    }
+};
+
+#endif
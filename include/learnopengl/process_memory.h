@@ -0,0 +1,19 @@
+#ifndef PROCESS_MEMORY_H
+#define PROCESS_MEMORY_H
+
+#include <cstddef>
+#include <fstream>
+
+#include <unistd.h>
+
+// resident set size of this process in bytes, 0 where /proc is not available
+inline size_t ResidentSetBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    size_t totalPages = 0, residentPages = 0;
+    if (!(statm >> totalPages >> residentPages))
+        return 0;
+    return residentPages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/filesystem.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+struct ProgramCacheHeader {
+    char     magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t length;
+};
+
+// Linked programs saved with glGetProgramBinary in resources/shaders/.cache, one "<key>.bin" per program.
+// The key hashes the program's sources together with the GL vendor, renderer and version strings, so
+// editing a shader or changing the driver picks a different file. A binary the driver no longer accepts
+// (it may reject its own after an update) fails to link, is deleted, and the program is compiled from
+// source again. Does nothing without GL_ARB_get_program_binary or when the driver has no binary formats.
+// GL thread only.
+class ProgramCache
+{
+public:
+    static const uint32_t Version = 1;
+
+    static bool Enabled()
+    {
+        static const bool enabled = supported();
+        return enabled;
+    }
+
+    // key of a program built from these parts (the source of each stage, in a fixed order) on this driver
+    static uint64_t Key(const std::vector<const std::string*> &parts)
+    {
+        uint64_t hash = 0xCBF29CE484222325ull;
+        for (const std::string *part : parts)
+        {
+            hash = hashBytes(hash, part->data(), part->size());
+            // keeps "ab" + "c" apart from "a" + "bc"
+            hash = hashBytes(hash, "\0", 1);
+        }
+        return hashBytes(hash, driver().data(), driver().size());
+    }
+
+    static std::string CachePath(uint64_t key)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return directory() + "/" + name;
+    }
+
+    // links program from the binary saved under key; false when there is none or the driver rejects it
+    static bool Load(unsigned int program, uint64_t key)
+    {
+        if (!Enabled())
+            return false;
+        std::string path = CachePath(key);
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        ProgramCacheHeader h;
+        in.read(reinterpret_cast<char*>(&h), sizeof(h));
+        std::vector<char> binary;
+        bool valid = in && std::memcmp(h.magic, "PRGB", 4) == 0 && h.version == Version && h.key == key && h.length > 0;
+        if (valid)
+        {
+            binary.resize(h.length);
+            in.read(binary.data(), binary.size());
+            valid = (bool)in;
+        }
+        in.close();
+        GLint linked = GL_FALSE;
+        if (valid)
+        {
+            glProgramBinary(program, h.binaryFormat, binary.data(), (GLsizei)binary.size());
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        }
+        if (!linked)
+        {
+            std::cout << "Program binary cache: " << path << " is stale, compiling from source" << std::endl;
+            std::remove(path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // call before linking a program that will be saved
+    static void PrepareLink(unsigned int program)
+    {
+        if (Enabled())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // saves the binary of a linked program under key
+    static bool Store(unsigned int program, uint64_t key)
+    {
+        if (!Enabled())
+            return false;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return false;
+        std::vector<char> binary(length);
+        GLenum binaryFormat = 0;
+        GLsizei written = 0;
+        glGetProgramBinary(program, length, &written, &binaryFormat, binary.data());
+        if (written <= 0)
+            return false;
+
+        ProgramCacheHeader h;
+        std::memcpy(h.magic, "PRGB", 4);
+        h.version = Version;
+        h.key = key;
+        h.binaryFormat = binaryFormat;
+        h.length = (uint32_t)written;
+
+        mkdir(directory().c_str(), 0755);
+        // write to a temporary file first so a crash never leaves a truncated binary behind
+        std::string cachePath = CachePath(key);
+        std::string tmpPath = cachePath + ".tmp";
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+            out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+            out.write(binary.data(), written);
+            if (!out)
+                return false;
+        }
+        return std::rename(tmpPath.c_str(), cachePath.c_str()) == 0;
+    }
+
+private:
+    static std::string directory()
+    {
+        return FileSystem::getPath("resources/shaders/.cache");
+    }
+
+    static bool supported()
+    {
+        if (!GLAD_GL_ARB_get_program_binary)
+            return false;
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    // identifies the driver binaries were made by
+    static const std::string &driver()
+    {
+        static const std::string name = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+        return name;
+    }
+
+    static std::string glString(GLenum name)
+    {
+        const GLubyte *value = glGetString(name);
+        return value ? (const char*)value : "";
+    }
+
+    static uint64_t hashBytes(uint64_t hash, const char *data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ (unsigned char)data[i]) * 0x100000001B3ull;
+        return hash;
+    }
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef RENDER_VIEW_H
+#define RENDER_VIEW_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+// camera position and frustum planes in the object space of one model instance, for culling its meshlets
+struct CullView {
+    glm::vec3 cameraPosition;
+    glm::vec4 planes[6];    // xyz . p + w >= 0 inside, xyz normalized
+};
+
+// What drawing code needs to know about the camera beyond the shader matrices, e.g. for picking a level of
+// detail from the size an object covers on screen or culling parts of it.
+struct RenderView {
+    glm::vec3 cameraPosition;
+    float pixelsPerUnit;    // on-screen size in pixels of a length of one seen from a distance of one
+    glm::vec4 planes[6];    // world space frustum planes: left, right, bottom, top, near, far
+
+    RenderView(const glm::vec3 &cameraPosition, float fovyDegrees, float viewportHeight, const glm::mat4 &viewProjection)
+        : cameraPosition(cameraPosition),
+          pixelsPerUnit(viewportHeight / (2.0f * std::tan(glm::radians(fovyDegrees) * 0.5f)))
+    {
+        // Gribb and Hartmann: the clip space conditions -w <= x, y, z <= w as planes of the matrix rows
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; i++)
+            rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+        for (int i = 0; i < 3; i++)
+        {
+            planes[2 * i] = normalizePlane(rows[3] + rows[i]);
+            planes[2 * i + 1] = normalizePlane(rows[3] - rows[i]);
+        }
+    }
+
+    // size in pixels of length seen from distance
+    float ProjectedSize(float length, float distance) const
+    {
+        return length * pixelsPerUnit / distance;
+    }
+
+    // the view as seen from inside a model drawn with transform. Culling against a sphere stays exact under
+    // any affine transform this way, where scaling the sphere into world space would not.
+    CullView ObjectSpace(const glm::mat4 &transform) const
+    {
+        CullView view;
+        view.cameraPosition = glm::vec3(glm::inverse(transform) * glm::vec4(cameraPosition, 1.0f));
+        glm::mat4 transposed = glm::transpose(transform);
+        for (int i = 0; i < 6; i++)
+            view.planes[i] = normalizePlane(transposed * planes[i]);
+        return view;
+    }
+
+private:
+    static glm::vec4 normalizePlane(const glm::vec4 &plane)
+    {
+        float length = glm::length(glm::vec3(plane));
+        return length > 0.0f ? plane * (1.0f / length) : plane;
+    }
+};
+
+// level of detail currently drawn for one instance of a model; kept between frames for the hysteresis
+struct LodState {
+    unsigned int level = 0;
+};
+
+#endif
@@ -4,28 +4,188 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
 #include <common.h>
+#include <learnopengl/program_cache.h>
+#include <learnopengl/uniform_blocks.h>
+
+// A uniform's name as a 64 bit FNV-1a hash. Made from a string literal no string is built, but the hash is
+// only computed at compile time where the name is a constant (static constexpr UniformName name("...")); a
+// literal passed straight to set*() is hashed on every call unless the optimizer folds it. Either way the
+// location comes from the shader's own table, not the driver.
+struct UniformName
+{
+    uint64_t hash;
+
+    template<size_t N>
+    constexpr UniformName(const char (&name)[N]) : hash(Hash(name, N - 1)) {}
+    UniformName(const std::string &name) : hash(Hash(name.data(), name.size())) {}
+
+    static constexpr uint64_t Hash(const char *name, size_t length)
+    {
+        uint64_t hash = 0xCBF29CE484222325ull;
+        for (size_t i = 0; i < length; i++)
+            hash = (hash ^ (unsigned char)name[i]) * 0x100000001B3ull;
+        return hash;
+    }
+};
+
+// glUniform* for each value type, on the program in use
+namespace UniformValue {
+    inline void Set(GLint location, bool value) { glUniform1i(location, (int)value); }
+    inline void Set(GLint location, int value) { glUniform1i(location, value); }
+    inline void Set(GLint location, unsigned int value) { glUniform1ui(location, value); }
+    inline void Set(GLint location, float value) { glUniform1f(location, value); }
+    inline void Set(GLint location, const glm::vec2 &value) { glUniform2fv(location, 1, &value[0]); }
+    inline void Set(GLint location, const glm::vec3 &value) { glUniform3fv(location, 1, &value[0]); }
+    inline void Set(GLint location, const glm::vec4 &value) { glUniform4fv(location, 1, &value[0]); }
+    inline void Set(GLint location, const glm::mat2 &value) { glUniformMatrix2fv(location, 1, GL_FALSE, &value[0][0]); }
+    inline void Set(GLint location, const glm::mat3 &value) { glUniformMatrix3fv(location, 1, GL_FALSE, &value[0][0]); }
+    inline void Set(GLint location, const glm::mat4 &value) { glUniformMatrix4fv(location, 1, GL_FALSE, &value[0][0]); }
+
+    // the GLSL type a value type sets, 0 for int, which also sets samplers
+    template<typename T> GLenum Type();
+    template<> inline GLenum Type<bool>() { return GL_BOOL; }
+    template<> inline GLenum Type<int>() { return 0; }
+    template<> inline GLenum Type<unsigned int>() { return GL_UNSIGNED_INT; }
+    template<> inline GLenum Type<float>() { return GL_FLOAT; }
+    template<> inline GLenum Type<glm::vec2>() { return GL_FLOAT_VEC2; }
+    template<> inline GLenum Type<glm::vec3>() { return GL_FLOAT_VEC3; }
+    template<> inline GLenum Type<glm::vec4>() { return GL_FLOAT_VEC4; }
+    template<> inline GLenum Type<glm::mat2>() { return GL_FLOAT_MAT2; }
+    template<> inline GLenum Type<glm::mat3>() { return GL_FLOAT_MAT3; }
+    template<> inline GLenum Type<glm::mat4>() { return GL_FLOAT_MAT4; }
+}
+
+// a uniform of a Shader resolved ahead of time (Shader::GetUniform), set on the program in use without
+// any lookup; location -1 (a uniform the program does not use) is ignored like by GL
+template<typename T>
+struct Uniform
+{
+    GLint location = -1;
+
+    void Set(const T &value) const { UniformValue::Set(location, value); }
+};
+
 class Shader
 {
 public:
     unsigned int ID;
+
+    // source code of a program's stages, read ahead of the compile (which needs the GL thread) by
+    // ReadSources, e.g. on a worker thread. geometry is empty when there is no geometry shader. defines
+    // ("#define ..." lines, see ShaderDefines) go after the #version line of every stage.
+    struct Sources {
+        std::string vertex;
+        std::string fragment;
+        std::string geometry;
+        std::string defines;
+    };
+
     // constructor generates the shader on the fly
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+        : Shader(ReadSources(vertexPath, fragmentPath, geometryPath))
     {
-        std::string vertexPathString(vertexPath);
-        std::string fragmentPathString(fragmentPath);
-
-        vertexPath = vertexPathString.c_str();
-        fragmentPath= fragmentPathString.c_str();
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
+    }
+    // submits the compile and link of already read sources, or links the program from the ProgramCache
+    // when it has a binary of them. Nothing waits for the driver here: the compile and link status are
+    // only checked by Finalize(), on first use, so with GL_KHR_parallel_shader_compile every program
+    // created up front compiles on the driver's threads in the meantime. Must run on the GL thread.
+    // ------------------------------------------------------------------------
+    explicit Shader(const Sources &sources) : fromCache(false)
+    {
+        enableParallelCompile();
+        uint64_t key = ProgramCache::Key({&sources.vertex, &sources.fragment, &sources.geometry, &sources.defines});
+        ID = glCreateProgram();
+        if (ProgramCache::Load(ID, key))
+        {
+            fromCache = true;
+            reflectUniforms();
+            bindUniformBlocks();
+            return;
+        }
+        std::string vertexCode = withDefines(sources.vertex, sources.defines);
+        std::string fragmentCode = withDefines(sources.fragment, sources.defines);
+        const char* vShaderCode = vertexCode.c_str();
+        const char * fShaderCode = fragmentCode.c_str();
+        bool hasGeometry = !sources.geometry.empty();
+        // 2. compile shaders
+        // vertex shader
+        build.vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(build.vertex, 1, &vShaderCode, NULL);
+        glCompileShader(build.vertex);
+        // fragment Shader
+        build.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(build.fragment, 1, &fShaderCode, NULL);
+        glCompileShader(build.fragment);
+        // if geometry shader is given, compile geometry shader
+        if(hasGeometry)
+        {
+            std::string geometryCode = withDefines(sources.geometry, sources.defines);
+            const char * gShaderCode = geometryCode.c_str();
+            build.geometry = glCreateShader(GL_GEOMETRY_SHADER);
+            glShaderSource(build.geometry, 1, &gShaderCode, NULL);
+            glCompileShader(build.geometry);
+        }
+        // shader Program
+        glAttachShader(ID, build.vertex);
+        glAttachShader(ID, build.fragment);
+        if(hasGeometry)
+            glAttachShader(ID, build.geometry);
+        ProgramCache::PrepareLink(ID);
+        glLinkProgram(ID);
+        build.key = key;
+        build.pending = true;
+    }
+    // whether the driver is done with the program, so Finalize() will not wait. Only known with
+    // GL_KHR_parallel_shader_compile; without it a program is ready once finalized.
+    // ------------------------------------------------------------------------
+    bool IsReady() const
+    {
+        if (!build.pending)
+            return true;
+        if (!GLAD_GL_KHR_parallel_shader_compile)
+            return false;
+        GLint done = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+    // waits for the compile and link submitted by the constructor, reports their errors, saves the
+    // program to the ProgramCache and reads its uniforms. Done by use() and the uniform lookups; call it
+    // earlier to take the wait at a better moment.
+    // ------------------------------------------------------------------------
+    void Finalize() const
+    {
+        if (!build.pending)
+            return;
+        build.pending = false;
+        checkCompileErrors(build.vertex, "VERTEX");
+        checkCompileErrors(build.fragment, "FRAGMENT");
+        if (build.geometry)
+            checkCompileErrors(build.geometry, "GEOMETRY");
+        if (checkCompileErrors(ID, "PROGRAM"))
+            ProgramCache::Store(ID, build.key);
+        reflectUniforms();
+        bindUniformBlocks();
+        // delete the shaders as they're linked into our program now and no longer necessery
+        glDeleteShader(build.vertex);
+        glDeleteShader(build.fragment);
+        if (build.geometry)
+            glDeleteShader(build.geometry);
+    }
+    // 1. retrieve the vertex/fragment source code from filePath. Touches no GL state.
+    // ------------------------------------------------------------------------
+    static Sources ReadSources(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
+    {
+        Sources sources;
         std::ifstream vShaderFile;
         std::ifstream fShaderFile;
         std::ifstream gShaderFile;
@@ -46,132 +206,246 @@ public:
             vShaderFile.close();
             fShaderFile.close();
             // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();			
+            sources.vertex = vShaderStream.str();
+            sources.fragment = fShaderStream.str();			
             // if geometry shader path is present, also load a geometry shader
             if(geometryPath != nullptr)
             {
-                std::string geometryPathString(geometryPath);
-                geometryPath = geometryPathString.c_str();
                 gShaderFile.open(geometryPath);
                 std::stringstream gShaderStream;
                 gShaderStream << gShaderFile.rdbuf();
                 gShaderFile.close();
-                geometryCode = gShaderStream.str();
+                sources.geometry = gShaderStream.str();
             }
         }
         catch (std::ifstream::failure& e)
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        const char* vShaderCode = vertexCode.c_str();
-        const char * fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
-        unsigned int vertex, fragment;
-        // vertex shader
-        vertex = glCreateShader(GL_VERTEX_SHADER);
-        glShaderSource(vertex, 1, &vShaderCode, NULL);
-        glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
-        // fragment Shader
-        fragment = glCreateShader(GL_FRAGMENT_SHADER);
-        glShaderSource(fragment, 1, &fShaderCode, NULL);
-        glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if(geometryPath != nullptr)
-        {
-            const char * gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
-        }
-        // shader Program
-        ID = glCreateProgram();
-        glAttachShader(ID, vertex);
-        glAttachShader(ID, fragment);
-        if(geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-        if(geometryPath != nullptr)
-            glDeleteShader(geometry);
-
+        return sources;
     }
+    // whether the program was linked from a cached binary instead of compiled
+    bool FromCache() const { return fromCache; }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
+        Finalize();
         glUseProgram(ID); 
     }
+    // location of an active uniform, -1 if the program has none of that name. Looked up in the table
+    // reflectUniforms() filled after linking, never in the driver.
+    // ------------------------------------------------------------------------
+    GLint Location(UniformName name) const
+    {
+        Finalize();
+        auto it = uniforms.find(name.hash);
+        return it != uniforms.end() ? it->second.location : -1;
+    }
+    // a handle to set the uniform with in the render loop, checked against its GLSL type
+    // ------------------------------------------------------------------------
+    template<typename T>
+    Uniform<T> GetUniform(const std::string &name) const
+    {
+        Finalize();
+        Uniform<T> uniform;
+        auto it = uniforms.find(UniformName(name).hash);
+        if (it == uniforms.end())
+            return uniform;
+        GLenum expected = UniformValue::Type<T>();
+        if (expected && it->second.type != expected)
+            std::cout << "ERROR::SHADER::UNIFORM_TYPE_MISMATCH: " << name << std::endl;
+        uniform.location = it->second.location;
+        return uniform;
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(UniformName name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(Location(name), (int)value); 
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(UniformName name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(Location(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(UniformName name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(Location(name), value); 
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(UniformName name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform2fv(Location(name), 1, &value[0]); 
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(UniformName name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(Location(name), x, y); 
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(UniformName name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform3fv(Location(name), 1, &value[0]); 
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(UniformName name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(Location(name), x, y, z); 
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(UniformName name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        glUniform4fv(Location(name), 1, &value[0]); 
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w) 
+    void setVec4(UniformName name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(Location(name), x, y, z, w); 
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(UniformName name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(Location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(UniformName name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(Location(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(UniformName name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(Location(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    bool fromCache;
+
+    // a compile and link submitted but not checked yet, see Finalize()
+    struct Build {
+        unsigned int vertex = 0;
+        unsigned int fragment = 0;
+        unsigned int geometry = 0;
+        uint64_t key = 0;
+        bool pending = false;
+    };
+    mutable Build build;
+
+    struct UniformInfo {
+        GLint location;
+        GLenum type;
+    };
+    // active uniforms by UniformName hash
+    mutable std::unordered_map<uint64_t, UniformInfo> uniforms;
+
+    void addUniform(const std::string &name, GLint location, GLenum type) const
+    {
+        auto inserted = uniforms.insert(std::make_pair(UniformName(name).hash, UniformInfo{location, type}));
+        if (!inserted.second && inserted.first->second.location != location)
+            std::cout << "ERROR::SHADER::UNIFORM_NAME_HASH_COLLISION: " << name << std::endl;
+    }
+
+    // fills the location table with every active uniform. Arrays are reported by their first element,
+    // "lights[0]", so the bare name and the other elements are added too. Uniforms in blocks have no
+    // location and are left out.
+    void reflectUniforms() const
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, i, buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0)
+                continue;
+            addUniform(name, location, type);
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string array = name.substr(0, name.size() - 3);
+                addUniform(array, location, type);
+                for (GLint element = 1; element < size; element++)
+                {
+                    std::string elementName = array + "[" + std::to_string(element) + "]";
+                    addUniform(elementName, glGetUniformLocation(ID, elementName.c_str()), type);
+                }
+            }
+        }
+    }
+
+    // points every uniform block the program declares at its binding in UniformBlocks and checks the
+    // layout the driver chose against the C++ mirror, so a struct that drifted from the GLSL shows up here
+    // instead of as wrong lighting
+    void bindUniformBlocks() const
+    {
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLchar buffer[256];
+            GLsizei length = 0;
+            glGetActiveUniformBlockName(ID, i, sizeof(buffer), &length, buffer);
+            std::string block(buffer, length);
+            int binding = UniformBlocks::BindingOf(block);
+            if (binding < 0)
+            {
+                std::cout << "ERROR::SHADER::UNKNOWN_UNIFORM_BLOCK: " << block << std::endl;
+                continue;
+            }
+            glUniformBlockBinding(ID, i, binding);
+
+            GLint size = 0;
+            glGetActiveUniformBlockiv(ID, i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+            if ((size_t)size != UniformBlocks::SizeOf(block))
+                std::cout << "ERROR::SHADER::UNIFORM_BLOCK_LAYOUT: " << block << " is " << size << " bytes, "
+                          << UniformBlocks::SizeOf(block) << " in C++" << std::endl;
+            for (const UniformBlocks::Member &member : UniformBlocks::Members(block))
+            {
+                const GLchar *name = member.name.c_str();
+                GLuint index = GL_INVALID_INDEX;
+                glGetUniformIndices(ID, 1, &name, &index);
+                if (index == GL_INVALID_INDEX)
+                    continue;
+                GLint offset = -1;
+                glGetActiveUniformsiv(ID, 1, &index, GL_UNIFORM_OFFSET, &offset);
+                if ((size_t)offset != member.offset)
+                    std::cout << "ERROR::SHADER::UNIFORM_BLOCK_LAYOUT: " << block << "." << member.name << " at "
+                              << offset << ", " << member.offset << " in C++" << std::endl;
+            }
+        }
+    }
+
+    // source with defines inserted after its #version line, which has to come first; a #line directive
+    // keeps the compiler's line numbers those of the file
+    static std::string withDefines(const std::string &source, const std::string &defines)
+    {
+        if (defines.empty())
+            return source;
+        size_t version = source.find("#version");
+        size_t end = version == std::string::npos ? std::string::npos : source.find('\n', version);
+        if (end == std::string::npos)
+            return defines + "#line 1\n" + source;
+        int nextLine = (int)std::count(source.begin(), source.begin() + end, '\n') + 2;
+        return source.substr(0, end + 1) + defines + "#line " + std::to_string(nextLine) + "\n" + source.substr(end + 1);
+    }
+
+    // lets the driver compile on as many threads as it likes, once per process
+    static void enableParallelCompile()
+    {
+        static bool enabled = false;
+        if (enabled || !GLAD_GL_KHR_parallel_shader_compile)
+            return;
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        enabled = true;
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
-    void checkCompileErrors(GLuint shader, std::string type)
+    bool checkCompileErrors(GLuint shader, std::string type) const
     {
         GLint success;
         GLchar infoLog[1024];
@@ -193,6 +467,7 @@ private:
                 std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
             }
         }
+        return success;
     }
 };
 #endif
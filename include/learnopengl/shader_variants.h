@@ -0,0 +1,123 @@
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <learnopengl/shader.h>
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The features a variant of a program is compiled with, as "#define <name> <value>" lines (see
+// Shader::Sources::defines). Shaders give every feature a default, so only the ones that differ need
+// setting, but a variant is identified by the exact set: set the same names every time.
+class ShaderDefines
+{
+public:
+    ShaderDefines &Set(const std::string &name, int value = 1)
+    {
+        values[name] = value;
+        return *this;
+    }
+
+    bool Empty() const { return values.empty(); }
+
+    // the #define lines, sorted by name so equal sets give equal text
+    std::string Text() const
+    {
+        std::string text;
+        for (const auto &value : values)
+            text += "#define " + value.first + " " + std::to_string(value.second) + "\n";
+        return text;
+    }
+
+    // "NAME=value,..." for logs
+    std::string Describe() const
+    {
+        std::string text;
+        for (const auto &value : values)
+            text += (text.empty() ? "" : ",") + value.first + "=" + std::to_string(value.second);
+        return text.empty() ? "-" : text;
+    }
+
+    // the smallest of 0, 1, 2, 4, 8, ... (capped at max) not below count, so a count compiled into a
+    // loop bound takes few variants
+    static int CountBucket(int count, int max)
+    {
+        int bucket = 0;
+        while (bucket < count && bucket < max)
+            bucket = bucket == 0 ? 1 : bucket * 2;
+        return bucket < max ? bucket : max;
+    }
+
+private:
+    std::map<std::string, int> values;
+};
+
+// The variants of one program by their defines. A variant is submitted for compiling the first time it
+// is asked for and kept for the rest of the run; like every Shader it is checked on first use, so asking
+// for the variant of the next frame's settings ahead of time hides most of its compile. GL thread only.
+class ShaderVariants
+{
+public:
+    // compiles the variant of defines right away, it is the one Default() returns
+    ShaderVariants(const Shader::Sources &sources, const ShaderDefines &defines)
+        : ShaderVariants(sources, std::vector<ShaderDefines>(1, defines))
+    {
+    }
+
+    // compiles every variant of startup right away; the first is the one Default() returns
+    ShaderVariants(const Shader::Sources &sources, const std::vector<ShaderDefines> &startup)
+        : sources(sources), defaultVariant(&variant(startup.front()))
+    {
+        for (const ShaderDefines &defines : startup)
+            variant(defines);
+    }
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    Shader &Default() const { return *defaultVariant; }
+
+    Shader &Get(const ShaderDefines &defines)
+    {
+        size_t count = variants.size();
+        Shader &shader = variant(defines);
+        // the startup ones are the manifest's, this one was not foreseen
+        if (variants.size() > count)
+            std::cout << "Compiling shader variant " << defines.Describe() << std::endl;
+        return shader;
+    }
+
+    // checks the variants the driver is done with (see Shader::IsReady())
+    void FinalizeReady() const
+    {
+        for (const auto &variant : variants)
+            if (variant.second->IsReady())
+                variant.second->Finalize();
+    }
+
+    size_t Count() const { return variants.size(); }
+
+private:
+    Shader::Sources sources;
+    std::unordered_map<std::string, std::unique_ptr<Shader>> variants;
+    Shader *defaultVariant;
+
+    // the variant of defines, submitted for compiling if there is none yet
+    Shader &variant(const ShaderDefines &defines)
+    {
+        std::string text = defines.Text();
+        std::unique_ptr<Shader> &shader = variants[text];
+        if (!shader)
+        {
+            Shader::Sources variantSources = sources;
+            variantSources.defines = text;
+            shader.reset(new Shader(variantSources));
+        }
+        return *shader;
+    }
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef STOPWATCH_H
+#define STOPWATCH_H
+
+#include <chrono>
+
+// Small wall-clock timer used for reporting asset load times.
+class Stopwatch
+{
+public:
+    Stopwatch() : start(std::chrono::steady_clock::now()) {}
+
+    void Reset()
+    {
+        start = std::chrono::steady_clock::now();
+    }
+
+    // milliseconds elapsed since construction or the last Reset()
+    double ElapsedMs() const
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
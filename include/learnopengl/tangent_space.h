@@ -0,0 +1,192 @@
+#ifndef TANGENT_SPACE_H
+#define TANGENT_SPACE_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Per-vertex tangent frames following MikkTSpace (mikktspace.c, the convention Blender, Substance and
+// xNormal bake normal maps in), so maps baked by those tools shade without seams:
+//  - every triangle's UV gradient is projected onto the plane of each corner's normal and weighted by the
+//    corner angle, so how a mesh is triangulated does not change the result;
+//  - triangles whose UV mapping is mirrored never share tangents with unmirrored ones: a vertex used by
+//    both is split in two;
+//  - triangles with degenerate UVs take the tangent of their neighbours, vertices without any usable
+//    neighbour (e.g. meshes without UVs) get an arbitrary frame around the normal.
+// The bitangent is cross(normal, tangent) times the handedness, which is what PackVertex stores.
+// Like MikkTSpace, vertices with the same position, normal and UV share their tangent whatever their index;
+// unlike it, fans of triangles that only touch at such a vertex are not told apart.
+namespace TangentSpace {
+
+    struct Face {
+        glm::vec3 s;            // unit direction of increasing U, 0 when the UVs are degenerate
+        bool preserving;        // UV winding matches the triangle winding
+        bool any;               // degenerate UVs: may join either orientation
+        bool degenerate;        // repeated corner position, ignored like in MikkTSpace
+    };
+
+    inline glm::vec3 projectSafe(const glm::vec3 &v, const glm::vec3 &n)
+    {
+        glm::vec3 p = v - n * glm::dot(n, v);
+        float length = glm::length(p);
+        return length > 0.0f ? p / length : p;
+    }
+
+    // a unit vector perpendicular to n
+    inline glm::vec3 anyTangent(const glm::vec3 &n)
+    {
+        glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        glm::vec3 t = glm::cross(axis, n);
+        float length = glm::length(t);
+        return length > 0.0f ? t / length : glm::vec3(1.0f, 0.0f, 0.0f);
+    }
+
+    // index of the first vertex with the same position, normal and UV as each vertex, which is how
+    // MikkTSpace decides what shares a tangent. Assimp's imports have one vertex per triangle corner.
+    inline std::vector<uint32_t> weldByValue(const std::vector<Vertex> &vertices)
+    {
+        std::vector<uint32_t> representative(vertices.size());
+        size_t tableSize = 16;
+        while (tableSize < 2 * vertices.size())
+            tableSize *= 2;
+        // vertex index + 1, 0 for an empty slot
+        std::vector<uint32_t> table(tableSize, 0);
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            const Vertex &v = vertices[i];
+            const float key[8] = { v.Position.x, v.Position.y, v.Position.z, v.Normal.x, v.Normal.y, v.Normal.z,
+                                   v.TexCoords.x, v.TexCoords.y };
+            uint64_t hash = 0xCBF29CE484222325ull;
+            for (float component : key)
+            {
+                uint32_t bits;
+                std::memcpy(&bits, &component, sizeof(bits));
+                hash = (hash ^ bits) * 0x100000001B3ull;
+            }
+            size_t slot = (size_t)(hash ^ (hash >> 29)) & (tableSize - 1);
+            for (;; slot = (slot + 1) & (tableSize - 1))
+            {
+                if (!table[slot])
+                {
+                    table[slot] = i + 1;
+                    representative[i] = i;
+                    break;
+                }
+                const Vertex &other = vertices[table[slot] - 1];
+                if (other.Position == v.Position && other.Normal == v.Normal && other.TexCoords == v.TexCoords)
+                {
+                    representative[i] = table[slot] - 1;
+                    break;
+                }
+            }
+        }
+        return representative;
+    }
+
+    // fills in Tangent and Bitangent of every vertex of a triangle list. Vertices shared by mirrored and
+    // unmirrored triangles are duplicated, so vertices may grow and indices change.
+    inline void Generate(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices)
+    {
+        size_t triangleCount = indices.size() / 3;
+        std::vector<Face> faces(triangleCount);
+        // bit 0: used by an orientation preserving triangle, bit 1: by a mirrored one
+        std::vector<uint8_t> orientations(vertices.size(), 0);
+        for (size_t f = 0; f < triangleCount; f++)
+        {
+            const Vertex &a = vertices[indices[3 * f]], &b = vertices[indices[3 * f + 1]], &c = vertices[indices[3 * f + 2]];
+            Face &face = faces[f];
+            face.s = glm::vec3(0.0f);
+            face.degenerate = a.Position == b.Position || a.Position == c.Position || b.Position == c.Position;
+            glm::vec3 d1 = b.Position - a.Position, d2 = c.Position - a.Position;
+            glm::vec2 t21 = b.TexCoords - a.TexCoords, t31 = c.TexCoords - a.TexCoords;
+            float signedArea = t21.x * t31.y - t21.y * t31.x;
+            face.preserving = signedArea > 0.0f;
+            face.any = true;
+            if (signedArea != 0.0f)
+            {
+                float sign = face.preserving ? 1.0f : -1.0f;
+                glm::vec3 s = d1 * t31.y - d2 * t21.y, t = d2 * t21.x - d1 * t31.x;
+                float lengthS = glm::length(s), lengthT = glm::length(t);
+                if (lengthS > 0.0f)
+                    face.s = s * (sign / lengthS);
+                face.any = lengthS == 0.0f || lengthT == 0.0f;
+            }
+            if (face.degenerate || face.any)
+                continue;
+            for (int k = 0; k < 3; k++)
+                orientations[indices[3 * f + k]] |= face.preserving ? 1 : 2;
+        }
+
+        // split the vertices both orientations use; the mirrored triangles get the copy
+        std::vector<uint32_t> mirroredCopy(vertices.size(), ~0u);
+        for (size_t i = 0, count = vertices.size(); i < count; i++)
+        {
+            if (orientations[i] == 3)
+            {
+                mirroredCopy[i] = vertices.size();
+                vertices.push_back(vertices[i]);
+                orientations[i] = 1;
+                orientations.push_back(2);
+            }
+        }
+        for (size_t f = 0; f < triangleCount; f++)
+            if (!faces[f].degenerate && !faces[f].any && !faces[f].preserving)
+                for (int k = 0; k < 3; k++)
+                    if (mirroredCopy[indices[3 * f + k]] != ~0u)
+                        indices[3 * f + k] = mirroredCopy[indices[3 * f + k]];
+
+        // angle weighted sum of the gradients, projected onto each corner's normal, per welded vertex and
+        // orientation: accumulator 2 * representative for preserving triangles, 2 * representative + 1 for mirrored
+        std::vector<uint32_t> representative = weldByValue(vertices);
+        std::vector<glm::vec3> tangents(2 * vertices.size(), glm::vec3(0.0f));
+        for (size_t f = 0; f < triangleCount; f++)
+        {
+            const Face &face = faces[f];
+            if (face.degenerate || face.any)
+                continue;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int index = indices[3 * f + k];
+                const Vertex &vertex = vertices[index];
+                const glm::vec3 &n = vertex.Normal;
+                glm::vec3 previous = vertices[indices[3 * f + (k + 2) % 3]].Position - vertex.Position;
+                glm::vec3 next = vertices[indices[3 * f + (k + 1) % 3]].Position - vertex.Position;
+                float cosine = glm::dot(projectSafe(previous, n), projectSafe(next, n));
+                float angle = std::acos(std::max(-1.0f, std::min(1.0f, cosine)));
+                tangents[2 * representative[index] + (face.preserving ? 0 : 1)] += projectSafe(face.s, n) * angle;
+            }
+        }
+
+        for (size_t i = 0; i < vertices.size(); i++)
+        {
+            Vertex &vertex = vertices[i];
+            // vertices only degenerate triangles use take whichever orientation their neighbours have
+            bool mirrored = orientations[i] == 2 || (orientations[i] == 0 && glm::length(tangents[2 * representative[i]]) == 0.0f
+                                                     && glm::length(tangents[2 * representative[i] + 1]) > 0.0f);
+            const glm::vec3 &sum = tangents[2 * representative[i] + (mirrored ? 1 : 0)];
+            float length = glm::length(sum);
+            vertex.Tangent = length > 0.0f ? sum / length : anyTangent(vertex.Normal);
+            vertex.Bitangent = glm::cross(vertex.Normal, vertex.Tangent) * (mirrored ? -1.0f : 1.0f);
+        }
+    }
+
+    inline void Generate(MeshData &mesh)
+    {
+        Generate(mesh.vertices, mesh.indices);
+    }
+
+    // every mesh on a core of its own
+    inline void GenerateAll(std::vector<MeshData> &meshes, ThreadPool &pool = ThreadPool::Shared())
+    {
+        pool.ParallelFor(meshes.size(), [&meshes](size_t i) { Generate(meshes[i]); });
+    }
+}
+
+#endif
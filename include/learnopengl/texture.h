@@ -0,0 +1,1175 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/gl_extensions.h>
+#include <learnopengl/mip_generator.h>
+#include <learnopengl/stopwatch.h>
+#include <learnopengl/texture_compress.h>
+#include <learnopengl/thread_pool.h>
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// An image decoded by stb_image. Decoding touches no GL state, so it is safe on worker threads.
+struct Image
+{
+    unsigned char *data = nullptr;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+
+    Image() {}
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
+    Image(Image &&other) { *this = std::move(other); }
+    Image& operator=(Image &&other)
+    {
+        std::swap(data, other.data);
+        std::swap(width, other.width);
+        std::swap(height, other.height);
+        std::swap(components, other.components);
+        return *this;
+    }
+    ~Image()
+    {
+        if (data)
+            stbi_image_free(data);
+    }
+
+    static Image Load(const std::string &path)
+    {
+        Image image;
+        image.data = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
+        return image;
+    }
+
+    size_t ByteSize() const
+    {
+        return (size_t)width * height * components;
+    }
+};
+
+// whether the driver can sample a block-compressed format, read as sRGB or linear. Safe on any thread once
+// GLExtensions::Load() ran; before that only the uncompressed path is used.
+bool CompressedFormatSupported(GLenum internalFormat, bool srgb)
+{
+    const GLExtensions &extensions = GLExtensions::Get();
+    if (!extensions.loaded)
+        return false;
+    switch (internalFormat)
+    {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+            return extensions.textureCompressionS3TC && (!srgb || extensions.textureSRGB);
+        case GL_COMPRESSED_RED_RGTC1:
+        case GL_COMPRESSED_RG_RGTC2:
+            // RGTC is core, but has no sRGB variant
+            return !srgb;
+    }
+    return false;
+}
+
+// The contents of a texture file. When the offline cooker wrote a block-compressed "<name>.ktx" next to the
+// image and the driver can sample it, that is loaded instead of decoding the PNG/JPG, otherwise the decoded
+// image gets its mip chain built on the CPU right away. Loading touches no GL state, so it is safe on worker
+// threads, and loading several textures on the pool filters their mips in parallel.
+struct TextureSource
+{
+    Image image;
+    MipChain mips;      // levels below the image's, empty for compressed textures
+    CompressedTexture compressed;
+
+    bool IsCompressed() const { return !compressed.levels.empty(); }
+    bool IsValid() const { return image.data || IsCompressed(); }
+    int Width() const { return IsCompressed() ? compressed.width : image.width; }
+    int Height() const { return IsCompressed() ? compressed.height : image.height; }
+
+    size_t ByteSize() const
+    {
+        return IsCompressed() ? compressed.ByteSize() : image.ByteSize() + mips.ByteSize();
+    }
+
+    static TextureSource Load(const std::string &path, bool gammaCorrection)
+    {
+        CompressedTexture cooked;
+        if (TextureCompression::ReadKTX(TextureCompression::CookedPath(path), cooked)
+                && CompressedFormatSupported(cooked.internalFormat, gammaCorrection))
+        {
+            TextureSource source;
+            source.compressed = std::move(cooked);
+            return source;
+        }
+        return LoadImage(path, gammaCorrection);
+    }
+
+    // decodes the image itself, ignoring any cooked file
+    static TextureSource LoadImage(const std::string &path, bool gammaCorrection)
+    {
+        TextureSource source;
+        source.image = Image::Load(path);
+        source.mips = MipGenerator::Generate(source.image.data, source.image.width, source.image.height,
+                                             source.image.components, gammaCorrection,
+                                             MipGenerator::LooksLikeNormalMap(path));
+        return source;
+    }
+};
+
+// Texture memory and upload time per format, accumulated over the run. GL thread only.
+// Upload times are measured on the CPU and include glGenerateMipmap for uncompressed textures without CPU mips.
+class TextureStats
+{
+public:
+    static TextureStats &Get()
+    {
+        static TextureStats stats;
+        return stats;
+    }
+
+    void Record(const std::string &format, size_t bytes, double milliseconds)
+    {
+        Entry &entry = byFormat[format];
+        entry.count++;
+        entry.bytes += bytes;
+        entry.milliseconds += milliseconds;
+    }
+
+    void Print() const
+    {
+        std::cout << "Texture uploads by format:" << std::endl;
+        for (const auto &format : byFormat)
+            std::cout << "  " << format.first << ": " << format.second.count << " textures, "
+                      << format.second.bytes / 1024 << " KiB, " << format.second.milliseconds << " ms" << std::endl;
+    }
+
+private:
+    struct Entry {
+        unsigned int count = 0;
+        size_t bytes = 0;
+        double milliseconds = 0.0;
+    };
+    std::map<std::string, Entry> byFormat;
+};
+
+// GPU memory of an uncompressed texture with a full mip chain (a third on top of the base level)
+size_t UncompressedTextureBytes(const Image &image)
+{
+    return image.ByteSize() * 4 / 3;
+}
+
+const char *UncompressedFormatName(int components, bool gammaCorrection)
+{
+    switch (components)
+    {
+        case 1: return "R8";
+        case 3: return gammaCorrection ? "SRGB8" : "RGB8";
+        case 4: return gammaCorrection ? "SRGB8_ALPHA8" : "RGBA8";
+    }
+    return "unknown";
+}
+
+const char *UncompressedFormatName(const Image &image, bool gammaCorrection)
+{
+    return UncompressedFormatName(image.components, gammaCorrection);
+}
+
+// the unsized formats decoded images of components channels are uploaded with
+void UncompressedFormats(int components, bool gammaCorrection, GLenum &internalFormat, GLenum &dataFormat)
+{
+    internalFormat = dataFormat = GL_RGB;
+    if (components == 1)
+    {
+        internalFormat = dataFormat = GL_RED;
+    }
+    else if (components == 3)
+    {
+        internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
+        dataFormat = GL_RGB;
+    }
+    else if (components == 4)
+    {
+        internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
+        dataFormat = GL_RGBA;
+    }
+}
+
+// specifies the levels of a CPU mip chain, from level 1 on, on target (a 2D texture or cubemap face) of the
+// bound texture. base points to the chain's data, or is the offset of it when a pixel unpack buffer holding
+// it is bound. Expects GL_UNPACK_ALIGNMENT 1.
+void UploadMipLevels(GLenum target, const MipChain &mips, GLenum internalFormat, GLenum dataFormat, const unsigned char *base)
+{
+    for (unsigned int i = 0; i < mips.levels.size(); i++)
+    {
+        const MipChain::Level &level = mips.levels[i];
+        glTexImage2D(target, i + 1, internalFormat, level.width, level.height, 0, dataFormat, GL_UNSIGNED_BYTE, base + level.offset);
+    }
+}
+
+// uploads a decoded image into a new mipmapped, repeating 2D texture, or respecifies textureID when given.
+// Must run on the GL thread. pixels defaults to the image data; pass a buffer offset when a pixel unpack
+// buffer is bound. The other levels come from mips when it has any, read from mipData (an offset likewise),
+// else from glGenerateMipmap.
+unsigned int UploadTexture2D(const Image &image, bool gammaCorrection, const void *pixels,
+                             const MipChain *mips = nullptr, const unsigned char *mipData = nullptr,
+                             unsigned int textureID = 0)
+{
+    if (!textureID)
+        glGenTextures(1, &textureID);
+
+    GLenum internalFormat, dataFormat;
+    UncompressedFormats(image.components, gammaCorrection, internalFormat, dataFormat);
+
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    // stb_image rows are tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.width, image.height, 0, dataFormat, GL_UNSIGNED_BYTE, pixels);
+    if (mips && !mips->Empty())
+    {
+        UploadMipLevels(GL_TEXTURE_2D, *mips, internalFormat, dataFormat, mipData);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mips->levels.size());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (!mips || mips->Empty())
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return textureID;
+}
+
+unsigned int UploadTexture2D(const Image &image, bool gammaCorrection)
+{
+    return UploadTexture2D(image, gammaCorrection, image.data);
+}
+
+// specifies every level of a cooked mip chain on target (a 2D texture or cubemap face) of the bound texture.
+// base points to the compressed data, or is null when a pixel unpack buffer holding it is bound.
+void UploadCompressedLevels(GLenum target, const CompressedTexture &texture, bool gammaCorrection, const unsigned char *base)
+{
+    GLenum internalFormat = TextureCompression::WithColorSpace(texture.internalFormat, gammaCorrection);
+    for (unsigned int i = 0; i < texture.levels.size(); i++)
+    {
+        const CompressedTexture::Level &level = texture.levels[i];
+        glCompressedTexImage2D(target, i, internalFormat, level.width, level.height, 0, level.size, base + level.offset);
+    }
+}
+
+// uploads a cooked texture with its precomputed mips into a new repeating 2D texture, or respecifies
+// textureID when given. Must run on the GL thread.
+unsigned int UploadCompressedTexture2D(const CompressedTexture &texture, bool gammaCorrection, const unsigned char *base,
+                                       unsigned int textureID = 0)
+{
+    if (!textureID)
+        glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    UploadCompressedLevels(GL_TEXTURE_2D, texture, gammaCorrection, base);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels.size() - 1);
+    if (texture.baseFormat == GL_RED)
+    {
+        // single channel maps (specular, displacement) are sampled as grey like their uncompressed originals
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    return textureID;
+}
+
+// uploads whichever form the source was loaded in and records it in the TextureStats
+unsigned int UploadTexture2D(const TextureSource &source, bool gammaCorrection, unsigned int textureID = 0)
+{
+    Stopwatch timer;
+    if (source.IsCompressed())
+    {
+        textureID = UploadCompressedTexture2D(source.compressed, gammaCorrection, source.compressed.data.data(), textureID);
+        TextureStats::Get().Record(TextureCompression::FormatName(source.compressed.internalFormat),
+                                   source.compressed.ByteSize(), timer.ElapsedMs());
+    }
+    else
+    {
+        textureID = UploadTexture2D(source.image, gammaCorrection, source.image.data, &source.mips, source.mips.data.data(), textureID);
+        TextureStats::Get().Record(UncompressedFormatName(source.image, gammaCorrection),
+                                   UncompressedTextureBytes(source.image), timer.ElapsedMs());
+    }
+    return textureID;
+}
+
+// specifies levels [first, last) of a loaded texture on the bound 2D texture, in the formats the uploads
+// above give them: level 0 is the image, the others come from its mip chain. False, and nothing uploaded,
+// if the source does not have those levels.
+bool UploadTextureLevels(const TextureSource &source, bool gammaCorrection, int first, int last)
+{
+    if (source.IsCompressed())
+    {
+        const CompressedTexture &texture = source.compressed;
+        if (last > (int)texture.levels.size())
+            return false;
+        GLenum internalFormat = TextureCompression::WithColorSpace(texture.internalFormat, gammaCorrection);
+        for (int i = first; i < last; i++)
+        {
+            const CompressedTexture::Level &level = texture.levels[i];
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height, 0, level.size,
+                                   texture.data.data() + level.offset);
+        }
+        return true;
+    }
+    if (last > 1 + (int)source.mips.levels.size())
+        return false;
+    GLenum internalFormat, dataFormat;
+    UncompressedFormats(source.image.components, gammaCorrection, internalFormat, dataFormat);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int i = first; i < last; i++)
+    {
+        if (i == 0)
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, source.image.width, source.image.height, 0, dataFormat,
+                         GL_UNSIGNED_BYTE, source.image.data);
+            continue;
+        }
+        const MipChain::Level &level = source.mips.levels[i - 1];
+        glTexImage2D(GL_TEXTURE_2D, i, internalFormat, level.width, level.height, 0, dataFormat, GL_UNSIGNED_BYTE,
+                     source.mips.data.data() + level.offset);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return true;
+}
+
+// Pixel buffer object used to stream texture data: the texels are copied into driver-owned memory and
+// the texture is specified from there, so the driver can schedule the transfer instead of stalling on it.
+class PixelUploadBuffer
+{
+public:
+    PixelUploadBuffer() : pbo(0) {}
+    ~PixelUploadBuffer()
+    {
+        if (pbo)
+            glDeleteBuffers(1, &pbo);
+    }
+    PixelUploadBuffer(const PixelUploadBuffer&) = delete;
+    PixelUploadBuffer& operator=(const PixelUploadBuffer&) = delete;
+
+    unsigned int Upload(const TextureSource &source, bool gammaCorrection)
+    {
+        Stopwatch timer;
+        unsigned int textureID;
+        if (source.IsCompressed())
+        {
+            const CompressedTexture &texture = source.compressed;
+            if (stage(texture.data.data(), texture.ByteSize()))
+            {
+                textureID = UploadCompressedTexture2D(texture, gammaCorrection, nullptr);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            }
+            else
+            {
+                textureID = UploadCompressedTexture2D(texture, gammaCorrection, texture.data.data());
+            }
+            TextureStats::Get().Record(TextureCompression::FormatName(texture.internalFormat), texture.ByteSize(), timer.ElapsedMs());
+        }
+        else
+        {
+            // the mips go right behind the image in the same buffer
+            const MipChain &mips = source.mips;
+            if (stage(source.image.data, source.image.ByteSize(), mips.data.data(), mips.ByteSize()))
+            {
+                const unsigned char *mipOffset = (const unsigned char*)source.image.ByteSize();
+                textureID = UploadTexture2D(source.image, gammaCorrection, nullptr, &mips, mipOffset);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            }
+            else
+            {
+                textureID = UploadTexture2D(source.image, gammaCorrection, source.image.data, &mips, mips.data.data());
+            }
+            TextureStats::Get().Record(UncompressedFormatName(source.image, gammaCorrection),
+                                       UncompressedTextureBytes(source.image), timer.ElapsedMs());
+        }
+        return textureID;
+    }
+
+private:
+    unsigned int pbo;
+
+    // copies bytes, then moreBytes of more behind them, into the buffer and leaves it bound; false (and
+    // unbound) if it could not be mapped
+    bool stage(const void *data, size_t bytes, const void *more = nullptr, size_t moreBytes = 0)
+    {
+        if (!pbo)
+            glGenBuffers(1, &pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        // orphan the previous storage so we never wait for the last upload to finish
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes + moreBytes, nullptr, GL_STREAM_DRAW);
+        void *mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes + moreBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!mapped)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return false;
+        }
+        std::memcpy(mapped, data, bytes);
+        if (moreBytes > 0)
+            std::memcpy((unsigned char*)mapped + bytes, more, moreBytes);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        return true;
+    }
+};
+
+enum TextureFlags {
+    TEXTURE_SRGB    = 1 << 0,
+    TEXTURE_CUBEMAP = 1 << 1,
+    TEXTURE_ARRAY   = 1 << 2
+};
+
+// Keeps the textures of the TextureRegistry within a GPU memory budget and at the resolution they are seen
+// at. The size of every level of every registered texture is read back from GL, and Use() records the
+// frame it was last bound in. Top mip levels are dropped by freeing them and raising GL_TEXTURE_BASE_LEVEL,
+// so the IDs held by meshes stay valid and no texels are read back:
+//  - RequestLevel() (fed by the TextureFeedback pass) gives the finest level a texture is sampled at on
+//    screen; once it has asked for a coarser level than the resident one for ReduceAfterRounds feedback
+//    rounds in a row, the levels above it are dropped;
+//  - a texture in use with finer levels wanted than resident (level 0 for textures no feedback governs)
+//    gets its file decoded on the thread pool, and only the missing levels are uploaded once the budget
+//    has room for them;
+//  - while the total is over budget the least recently used 2D textures shrink regardless: ones idle for
+//    a few frames straight down to MinResidentSize, ones still drawn a level at a time.
+// Cubemaps and texture arrays are counted but never reduced. GL thread only.
+class TextureResidency
+{
+public:
+    // textures are not reduced below this width or height
+    static const int MinResidentSize = 32;
+    // textures bound within this many frames count as in use
+    static const uint64_t InUseFrames = 3;
+    // feedback rounds a texture must be seen coarser in before its top levels go, so a camera turning
+    // back and forth does not decode the file again every time
+    static const int ReduceAfterRounds = 4;
+
+    static TextureResidency &Get()
+    {
+        static TextureResidency residency;
+        return residency;
+    }
+
+    // bytes all tracked textures may take together, 0 for no limit
+    void SetBudget(size_t bytes) { budget = bytes; }
+    size_t Budget() const { return budget; }
+
+    size_t ResidentBytes() const { return residentBytes; }
+    // what the tracked textures would take at full resolution
+    size_t FullBytes() const { return fullBytes; }
+    size_t TextureCount() const { return entries.size(); }
+    size_t ReducedCount() const
+    {
+        size_t reduced = 0;
+        for (const auto &entry : entries)
+            reduced += entry.second.dropped > 0;
+        return reduced;
+    }
+    size_t Reductions() const { return reductions; }
+    size_t Reloads() const { return reloads; }
+    size_t PendingReloads() const { return pendingReloads; }
+
+    // width or height of level 0 of a tracked texture, whichever is larger; 0 if it is not tracked
+    int FullSize(unsigned int textureID) const
+    {
+        auto it = entries.find(textureID);
+        return it != entries.end() ? it->second.size : 0;
+    }
+
+    // starts accounting for a texture the registry just created under key
+    void Track(unsigned int textureID, const std::string &key)
+    {
+        Entry &entry = entries[textureID];
+        entry = Entry();
+        entry.key = key;
+        entry.generation = ++generations;
+        entry.lastUsed = frame;
+        size_t separator = key.find_last_of('|');
+        unsigned int flags = separator != std::string::npos ? std::atoi(key.c_str() + separator + 1) : 0;
+        entry.target = (flags & TEXTURE_CUBEMAP) ? GL_TEXTURE_CUBE_MAP : (flags & TEXTURE_ARRAY) ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+        entry.srgb = (flags & TEXTURE_SRGB) != 0;
+        measure(textureID, entry);
+        fullBytes += entry.fullBytes;
+        residentBytes += entry.residentBytes;
+    }
+
+    // stops accounting for a texture about to be deleted; a reload still in flight is dropped when it arrives
+    void Untrack(unsigned int textureID)
+    {
+        auto it = entries.find(textureID);
+        if (it == entries.end())
+            return;
+        fullBytes -= it->second.fullBytes;
+        residentBytes -= it->second.residentBytes;
+        if (it->second.reloading)
+            pendingBytes -= it->second.reloadBytes;
+        entries.erase(it);
+    }
+
+    // records that the texture is drawn with this frame
+    void Use(unsigned int textureID)
+    {
+        auto it = entries.find(textureID);
+        if (it != entries.end())
+            it->second.lastUsed = frame;
+    }
+
+    // the finest mip level a feedback round saw the texture sampled at; levels past the coarsest one that
+    // may be dropped ask for that one (textures the round did not see at all pass INT_MAX)
+    void RequestLevel(unsigned int textureID, int level)
+    {
+        auto it = entries.find(textureID);
+        if (it == entries.end() || it->second.target != GL_TEXTURE_2D)
+            return;
+        Entry &entry = it->second;
+        entry.wanted = std::max(0, std::min(level, entry.maxDropped));
+        if (entry.wanted > entry.dropped)
+        {
+            entry.coarser = entry.coarserRounds++ > 0 ? std::min(entry.coarser, entry.wanted) : entry.wanted;
+        }
+        else
+        {
+            entry.coarserRounds = 0;
+        }
+    }
+
+    // call once per frame before drawing: uploads finished reloads, drops the levels feedback has not
+    // needed for a while, starts the reloads of textures in use with levels missing and reduces textures
+    // until the total fits the budget
+    void BeginFrame()
+    {
+        frame++;
+        std::pair<std::pair<unsigned int, uint64_t>, TextureSource> reloaded;
+        while (finished.TryPop(reloaded))
+        {
+            pendingReloads--;
+            auto it = entries.find(reloaded.first.first);
+            if (it == entries.end() || it->second.generation != reloaded.first.second)
+                continue;
+            Entry &entry = it->second;
+            entry.reloading = false;
+            pendingBytes -= entry.reloadBytes;
+            if (!reloaded.second.IsValid())
+                continue;
+            glBindTexture(GL_TEXTURE_2D, it->first);
+            if (!UploadTextureLevels(reloaded.second, entry.srgb, entry.reloadTarget, entry.dropped))
+            {
+                // the file changed since the texture was made: take it whole
+                fullBytes -= entry.fullBytes;
+                residentBytes -= entry.residentBytes;
+                UploadTexture2D(reloaded.second, entry.srgb, it->first);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+                measure(it->first, entry);
+                fullBytes += entry.fullBytes;
+                residentBytes += entry.residentBytes;
+                reloads++;
+                continue;
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.reloadTarget);
+            setDropped(entry, entry.reloadTarget);
+            reloads++;
+        }
+
+        for (auto &it : entries)
+        {
+            Entry &entry = it.second;
+            if (entry.coarserRounds >= ReduceAfterRounds && !entry.reloading && entry.coarser > entry.dropped)
+                reduce(it.first, entry, entry.coarser);
+        }
+
+        for (auto &it : entries)
+        {
+            Entry &entry = it.second;
+            if (entry.wanted >= entry.dropped || entry.reloading || !inUse(entry))
+                continue;
+            size_t needed = entry.BytesFrom(entry.wanted) - entry.residentBytes;
+            if (budget && !makeRoom(needed))
+                continue;
+            startReload(it.first, entry, entry.wanted, needed);
+        }
+
+        while (budget && residentBytes + pendingBytes > budget)
+        {
+            // least recently used texture that can still shrink
+            auto victim = entries.end();
+            for (auto it = entries.begin(); it != entries.end(); ++it)
+                if (it->second.Reducible() && (victim == entries.end() || it->second.lastUsed < victim->second.lastUsed))
+                    victim = it;
+            if (victim == entries.end())
+                break;
+            Entry &entry = victim->second;
+            reduce(victim->first, entry, inUse(entry) ? entry.dropped + 1 : entry.maxDropped);
+        }
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation = 0;        // tells a reload apart from one for an earlier texture with the same ID
+        GLenum target = GL_TEXTURE_2D;
+        bool srgb = false;
+        bool compressed = false;
+        int texelBytes = 0;
+        int size = 0;                   // larger side of level 0
+        std::vector<size_t> levelBytes; // of every level at full resolution, all faces or layers together
+        int dropped = 0;                // top levels currently dropped, the texture's base level
+        int maxDropped = 0;             // dropping more would go below MinResidentSize
+        int wanted = 0;                 // finest level the last feedback round asked for
+        int coarser = 0;                // finest level asked for while every round asked coarser than dropped
+        int coarserRounds = 0;          // ... and how many rounds that has been
+        size_t fullBytes = 0;
+        size_t residentBytes = 0;
+        uint64_t lastUsed = 0;
+        bool reloading = false;
+        int reloadTarget = 0;           // base level once the reload is in
+        size_t reloadBytes = 0;         // counted in pendingBytes while reloading
+
+        bool Reducible() const { return target == GL_TEXTURE_2D && !reloading && dropped < maxDropped; }
+
+        size_t BytesFrom(int level) const
+        {
+            size_t bytes = 0;
+            for (size_t i = level; i < levelBytes.size(); i++)
+                bytes += levelBytes[i];
+            return bytes;
+        }
+    };
+
+    TextureResidency() : budget(0), residentBytes(0), fullBytes(0), pendingBytes(0), frame(0), generations(0),
+                         reductions(0), reloads(0), pendingReloads(0) {}
+
+    bool inUse(const Entry &entry) const { return entry.lastUsed + InUseFrames > frame; }
+
+    static size_t levelBytes(GLenum target, int level, const Entry &entry)
+    {
+        GLint width = 0, height = 0, size = 0;
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_HEIGHT, &height);
+        if (!entry.compressed)
+            return (size_t)width * height * entry.texelBytes;
+        glGetTexLevelParameteriv(target, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+        return size;
+    }
+
+    // format, level count and size of a texture as the driver holds it at full resolution
+    static void measure(unsigned int textureID, Entry &entry)
+    {
+        GLenum face = entry.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X : entry.target;
+        glBindTexture(entry.target, textureID);
+        entry.levelBytes.clear();
+        entry.dropped = entry.maxDropped = entry.wanted = entry.coarserRounds = 0;
+        entry.fullBytes = entry.residentBytes = 0;
+        GLint width = 0, height = 0, compressed = 0, internalFormat = 0, maxLevel = 1000;
+        glGetTexLevelParameteriv(face, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(face, 0, GL_TEXTURE_HEIGHT, &height);
+        if (width == 0 || height == 0)
+            return;     // never specified (failed to load)
+        glGetTexLevelParameteriv(face, 0, GL_TEXTURE_COMPRESSED, &compressed);
+        glGetTexLevelParameteriv(face, 0, GL_TEXTURE_INTERNAL_FORMAT, &internalFormat);
+        glGetTexParameteriv(entry.target, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+        GLint layers = entry.target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+        if (entry.target == GL_TEXTURE_2D_ARRAY)
+            glGetTexLevelParameteriv(face, 0, GL_TEXTURE_DEPTH, &layers);
+        entry.compressed = compressed != 0;
+        entry.size = std::max(width, height);
+        switch (internalFormat)
+        {
+            case GL_RED: case GL_R8:
+                entry.texelBytes = 1;
+                break;
+            default:
+                // drivers pad three channel texels to four bytes
+                entry.texelBytes = 4;
+                break;
+        }
+        int levels = 1;
+        for (int w = width, h = height; (w > 1 || h > 1) && levels <= maxLevel; levels++)
+        {
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+        }
+        while (std::max(width >> (entry.maxDropped + 1), height >> (entry.maxDropped + 1)) >= MinResidentSize
+               && entry.maxDropped + 1 < levels)
+            entry.maxDropped++;
+        for (int level = 0; level < levels; level++)
+            entry.levelBytes.push_back(levelBytes(face, level, entry) * layers);
+        entry.fullBytes = entry.residentBytes = entry.BytesFrom(0);
+    }
+
+    void setDropped(Entry &entry, int dropped)
+    {
+        residentBytes -= entry.residentBytes;
+        entry.dropped = dropped;
+        entry.residentBytes = entry.BytesFrom(dropped);
+        residentBytes += entry.residentBytes;
+        entry.coarserRounds = 0;
+    }
+
+    // drops top levels until `dropped` of the full chain are gone: they are freed by giving them a size of
+    // zero and the base level moves past them
+    void reduce(unsigned int textureID, Entry &entry, int dropped)
+    {
+        dropped = std::min(dropped, entry.maxDropped);
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, dropped);
+        for (int level = entry.dropped; level < dropped; level++)
+            glTexImage2D(GL_TEXTURE_2D, level, GL_R8, 0, 0, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+        setDropped(entry, dropped);
+        reductions++;
+    }
+
+    // reduces textures that are not in use until bytes more fit the budget; false if they cannot
+    bool makeRoom(size_t bytes)
+    {
+        while (residentBytes + pendingBytes + bytes > budget)
+        {
+            auto victim = entries.end();
+            for (auto it = entries.begin(); it != entries.end(); ++it)
+                if (it->second.Reducible() && !inUse(it->second)
+                        && (victim == entries.end() || it->second.lastUsed < victim->second.lastUsed))
+                    victim = it;
+            if (victim == entries.end())
+                return false;
+            reduce(victim->first, victim->second, victim->second.maxDropped);
+        }
+        return true;
+    }
+
+    void startReload(unsigned int textureID, Entry &entry, int target, size_t bytes)
+    {
+        entry.reloading = true;
+        entry.reloadTarget = target;
+        entry.reloadBytes = bytes;
+        pendingBytes += bytes;
+        pendingReloads++;
+        std::string path = entry.key.substr(0, entry.key.find_last_of('|'));
+        bool srgb = entry.srgb;
+        std::pair<unsigned int, uint64_t> id(textureID, entry.generation);
+        CompletionQueue<std::pair<std::pair<unsigned int, uint64_t>, TextureSource>> *queue = &finished;
+        ThreadPool::Shared().Submit([id, path, srgb, queue] {
+            queue->Push(std::make_pair(id, TextureSource::Load(path, srgb)));
+        });
+    }
+
+    std::unordered_map<unsigned int, Entry> entries;
+    CompletionQueue<std::pair<std::pair<unsigned int, uint64_t>, TextureSource>> finished;
+    size_t budget;
+    size_t residentBytes;
+    size_t fullBytes;
+    size_t pendingBytes;        // reloads on their way in
+    uint64_t frame;
+    uint64_t generations;
+    size_t reductions;
+    size_t reloads;
+    size_t pendingReloads;
+};
+
+// binds a texture on the active unit and marks it used for the TextureResidency
+inline void BindTexture(GLenum target, unsigned int textureID)
+{
+    TextureResidency::Get().Use(textureID);
+    glBindTexture(target, textureID);
+}
+
+// Process-wide registry of loaded textures keyed by canonical file path plus TextureFlags, so an image that
+// several models, block types or the skybox refer to is decoded and uploaded only once. Handles are
+// refcounted: every successful Acquire()/Insert() must be balanced by a Release(). GL thread only.
+class TextureRegistry
+{
+public:
+    static TextureRegistry &Get()
+    {
+        static TextureRegistry registry;
+        return registry;
+    }
+
+    // "<canonical path>|<flags>"; paths that cannot be resolved are used as given
+    static std::string MakeKey(const std::string &path, unsigned int flags)
+    {
+        char resolved[PATH_MAX];
+        std::string canonical = realpath(path.c_str(), resolved) ? std::string(resolved) : path;
+        return canonical + '|' + std::to_string(flags);
+    }
+
+    // returns the texture registered under key with its refcount incremented, or 0 if there is none
+    unsigned int Acquire(const std::string &key)
+    {
+        auto it = byKey.find(key);
+        if (it == byKey.end())
+            return 0;
+        entries[it->second].refCount++;
+        return it->second;
+    }
+
+    // registers a freshly created texture with a refcount of one
+    void Insert(const std::string &key, unsigned int textureID)
+    {
+        byKey[key] = textureID;
+        Entry &entry = entries[textureID];
+        entry.key = key;
+        entry.refCount = 1;
+        TextureResidency::Get().Track(textureID, key);
+    }
+
+    // drops one reference and deletes the GL texture with the last one
+    void Release(unsigned int textureID)
+    {
+        auto it = entries.find(textureID);
+        if (it == entries.end() || --it->second.refCount > 0)
+            return;
+        byKey.erase(it->second.key);
+        entries.erase(it);
+        TextureResidency::Get().Untrack(textureID);
+        glDeleteTextures(1, &textureID);
+    }
+
+    size_t Size() const { return entries.size(); }
+
+private:
+    struct Entry {
+        std::string key;
+        unsigned int refCount;
+    };
+    std::unordered_map<std::string, unsigned int> byKey;
+    std::unordered_map<unsigned int, Entry> entries;
+};
+
+// loads a 2D texture through the registry, decoding it only if nobody loaded it before
+unsigned int AcquireTexture2D(const std::string &path, bool gammaCorrection)
+{
+    std::string key = TextureRegistry::MakeKey(path, gammaCorrection ? TEXTURE_SRGB : 0);
+    unsigned int textureID = TextureRegistry::Get().Acquire(key);
+    if (textureID)
+        return textureID;
+
+    TextureSource source = TextureSource::Load(path, gammaCorrection);
+    if (source.IsValid())
+    {
+        textureID = UploadTexture2D(source, gammaCorrection);
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+        glGenTextures(1, &textureID);
+    }
+    TextureRegistry::Get().Insert(key, textureID);
+    return textureID;
+}
+
+// decodes all images on the shared thread pool at once while the calling (GL) thread uploads each one as
+// soon as it is ready. Textures already in the registry are reused, and every returned ID holds one
+// registry reference. Returns the texture IDs in the order of the given paths.
+std::vector<unsigned int> LoadTexturesParallel(const std::vector<std::string> &paths, bool gammaCorrection)
+{
+    TextureRegistry &registry = TextureRegistry::Get();
+    std::vector<unsigned int> ids(paths.size(), 0);
+    std::vector<std::string> keys(paths.size());
+    std::unordered_map<std::string, size_t> firstWithKey;
+    // shared with the jobs: a worker may still be inside Push() when the last result has been popped
+    std::shared_ptr<CompletionQueue<std::pair<size_t, TextureSource>>> decoded =
+            std::make_shared<CompletionQueue<std::pair<size_t, TextureSource>>>();
+    size_t pending = 0;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        keys[i] = TextureRegistry::MakeKey(paths[i], gammaCorrection ? TEXTURE_SRGB : 0);
+        ids[i] = registry.Acquire(keys[i]);
+        if (ids[i] || !firstWithKey.insert(std::make_pair(keys[i], i)).second)
+            continue;
+        const std::string path = paths[i];
+        ThreadPool::Shared().Submit([i, path, gammaCorrection, decoded] {
+            decoded->Push(std::make_pair(i, TextureSource::Load(path, gammaCorrection)));
+        });
+        pending++;
+    }
+    for (size_t n = 0; n < pending; n++)
+    {
+        std::pair<size_t, TextureSource> result = decoded->Pop();
+        unsigned int &id = ids[result.first];
+        if (result.second.IsValid())
+        {
+            id = UploadTexture2D(result.second, gammaCorrection);
+        }
+        else
+        {
+            std::cout << "Texture failed to load at path: " << paths[result.first] << std::endl;
+            glGenTextures(1, &id);
+        }
+        registry.Insert(keys[result.first], id);
+    }
+    // paths that appeared more than once in this batch share the first one's texture
+    for (size_t i = 0; i < paths.size(); i++)
+        if (!ids[i])
+            ids[i] = registry.Acquire(keys[i]);
+    return ids;
+}
+
+// the distinct files among a cubemap's faces, and for every face the index of its file
+void CubemapFiles(const std::vector<std::string> &faces, std::vector<std::string> &files, std::vector<size_t> &fileOfFace)
+{
+    std::unordered_map<std::string, size_t> byPath;
+    fileOfFace.resize(faces.size());
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        auto inserted = byPath.insert(std::make_pair(TextureRegistry::MakeKey(faces[i], 0), files.size()));
+        if (inserted.second)
+            files.push_back(faces[i]);
+        fileOfFace[i] = inserted.first->second;
+    }
+}
+
+// registry key of the cubemap made of faces
+std::string CubemapKey(const std::vector<std::string> &faces)
+{
+    std::string key;
+    for (const std::string &face : faces)
+        key += TextureRegistry::MakeKey(face, TEXTURE_CUBEMAP) + '\n';
+    return key;
+}
+
+// creates a cubemap from the decoded files of its faces (see CubemapFiles) and registers it under
+// CubemapKey(faces). Must run on the GL thread. The cubemap gets a full mip chain: the cooked one when all
+// files have a cooked version of the same format (otherwise the images are decoded again, on the shared
+// thread pool), else the one TextureSource built on the CPU, and glGenerateMipmap only if a face failed to load.
+unsigned int UploadCubemap(const std::vector<std::string> &faces, const std::vector<std::string> &files,
+                           const std::vector<size_t> &fileOfFace, std::vector<TextureSource> &sources)
+{
+    Stopwatch timer;
+    // cooked faces are only used if all of them share one compressed format, a mixed cubemap would be incomplete
+    bool compressed = true;
+    for (const TextureSource &source : sources)
+        compressed = compressed && source.IsCompressed()
+                && source.compressed.internalFormat == sources[0].compressed.internalFormat
+                && source.compressed.levels.size() == sources[0].compressed.levels.size();
+    if (!compressed)
+    {
+        std::vector<std::future<TextureSource>> images;
+        for (size_t i = 0; i < sources.size(); i++)
+        {
+            std::string path = files[i];
+            if (sources[i].IsCompressed())
+                images.push_back(ThreadPool::Shared().Submit([path] { return TextureSource::LoadImage(path, false); }));
+        }
+        for (size_t i = 0, next = 0; i < sources.size(); i++)
+            if (sources[i].IsCompressed())
+                sources[i] = images[next++].get();
+    }
+    // every face needs the same number of levels for the cubemap to be complete
+    bool cpuMips = !compressed;
+    for (const TextureSource &source : sources)
+        cpuMips = cpuMips && !source.mips.Empty() && source.mips.levels.size() == sources[0].mips.levels.size();
+
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    size_t bytes = 0;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (unsigned int i = 0; i < faces.size(); i++)
+    {
+        const TextureSource &source = sources[fileOfFace[i]];
+        if (compressed)
+        {
+            UploadCompressedLevels(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, source.compressed, false, source.compressed.data.data());
+            bytes += source.ByteSize();
+            continue;
+        }
+        const Image &image = source.image;
+        if (image.data)
+        {
+            GLenum format = image.components == 4 ? GL_RGBA : image.components == 1 ? GL_RED : GL_RGB;
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.data);
+            if (cpuMips)
+                UploadMipLevels(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, source.mips, format, format, source.mips.data.data());
+            bytes += UncompressedTextureBytes(image);
+        }
+        else
+        {
+            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (compressed)
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, sources[0].compressed.levels.size() - 1);
+    else if (cpuMips)
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, sources[0].mips.levels.size());
+    else
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    TextureStats::Get().Record(compressed ? TextureCompression::FormatName(sources[0].compressed.internalFormat)
+                                          : UncompressedFormatName(sources[0].image, false),
+                               bytes, timer.ElapsedMs());
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    TextureRegistry::Get().Insert(CubemapKey(faces), textureID);
+    return textureID;
+}
+
+// loads a cubemap from 6 face images, in the order +X, -X, +Y, -Y, +Z, -Z, through the registry.
+// Every distinct file is decoded once, all of them at the same time on the shared thread pool, and faces
+// naming the same file are uploaded from the one decoded image.
+unsigned int LoadCubemap(const std::vector<std::string> &faces)
+{
+    unsigned int textureID = TextureRegistry::Get().Acquire(CubemapKey(faces));
+    if (textureID)
+        return textureID;
+
+    Stopwatch timer;
+    std::vector<std::string> files;
+    std::vector<size_t> fileOfFace;
+    CubemapFiles(faces, files, fileOfFace);
+    std::vector<std::future<TextureSource>> decodes;
+    for (const std::string &path : files)
+        decodes.push_back(ThreadPool::Shared().Submit([path] { return TextureSource::Load(path, false); }));
+    std::vector<TextureSource> sources;
+    for (std::future<TextureSource> &decode : decodes)
+        sources.push_back(decode.get());
+    double decodeMs = timer.ElapsedMs();
+
+    textureID = UploadCubemap(faces, files, fileOfFace, sources);
+    std::cout << "Cubemap: " << faces.size() << " faces from " << files.size() << " files, decoded on "
+              << ThreadPool::Shared().Size() << " threads in " << decodeMs << " ms, " << timer.ElapsedMs()
+              << " ms in total" << std::endl;
+    return textureID;
+}
+
+// registry key of the texture array made of layers
+std::string TextureArrayKey(const std::vector<std::string> &layers, bool gammaCorrection)
+{
+    std::string key;
+    for (const std::string &layer : layers)
+        key += TextureRegistry::MakeKey(layer, TEXTURE_ARRAY | (gammaCorrection ? TEXTURE_SRGB : 0)) + '\n';
+    return key;
+}
+
+// the texels of image bilinearly resampled to width x height, with components channels: grey images
+// repeat their value in the colour channels, a missing alpha channel is opaque
+std::vector<unsigned char> ConformImage(const Image &image, int width, int height, int components)
+{
+    std::vector<unsigned char> texels((size_t)width * height * components);
+    float scaleX = (float)image.width / width, scaleY = (float)image.height / height;
+    for (int y = 0; y < height; y++)
+    {
+        float sy = std::min(std::max((y + 0.5f) * scaleY - 0.5f, 0.0f), (float)(image.height - 1));
+        int y0 = (int)sy, y1 = std::min(y0 + 1, image.height - 1);
+        float fy = sy - y0;
+        for (int x = 0; x < width; x++)
+        {
+            float sx = std::min(std::max((x + 0.5f) * scaleX - 0.5f, 0.0f), (float)(image.width - 1));
+            int x0 = (int)sx, x1 = std::min(x0 + 1, image.width - 1);
+            float fx = sx - x0;
+            unsigned char *out = &texels[((size_t)y * width + x) * components];
+            for (int c = 0; c < components; c++)
+            {
+                if (c == 3 && image.components < 4)
+                {
+                    out[c] = 255;
+                    continue;
+                }
+                int source = std::min(c, image.components - 1);
+                auto at = [&](int sx, int sy) { return (float)image.data[((size_t)sy * image.width + sx) * image.components + source]; };
+                float top = at(x0, y0) + (at(x1, y0) - at(x0, y0)) * fx;
+                float bottom = at(x0, y1) + (at(x1, y1) - at(x0, y1)) * fx;
+                out[c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+            }
+        }
+    }
+    return texels;
+}
+
+// creates a mipmapped, repeating GL_TEXTURE_2D_ARRAY with one layer per decoded image and registers it
+// under TextureArrayKey(layers, gammaCorrection). An array has one size and format for all its layers, so
+// images smaller than the largest one, or with fewer channels than the most any has, are resampled to
+// match (and get their mips built again); layers that failed to load are black. Must run on the GL thread.
+unsigned int UploadTextureArray(const std::vector<std::string> &layers, std::vector<TextureSource> &sources,
+                                bool gammaCorrection)
+{
+    Stopwatch timer;
+    int width = 1, height = 1, components = 1;
+    for (const TextureSource &source : sources)
+    {
+        if (!source.image.data)
+            continue;
+        width = std::max(width, source.image.width);
+        height = std::max(height, source.image.height);
+        components = std::max(components, source.image.components);
+    }
+    // the level 0 texels and mips of every layer, from the source itself when it already fits
+    std::vector<std::vector<unsigned char>> conformed(sources.size());
+    std::vector<MipChain> regenerated(sources.size());
+    std::vector<const unsigned char*> texels(sources.size());
+    std::vector<const MipChain*> mips(sources.size());
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        const Image &image = sources[i].image;
+        if (image.data && image.width == width && image.height == height && image.components == components
+                && !sources[i].mips.Empty())
+        {
+            texels[i] = image.data;
+            mips[i] = &sources[i].mips;
+            continue;
+        }
+        if (image.data)
+            conformed[i] = ConformImage(image, width, height, components);
+        else
+        {
+            std::cout << "Texture array layer failed to load at path: " << layers[i] << std::endl;
+            conformed[i].assign((size_t)width * height * components, 0);
+        }
+        regenerated[i] = MipGenerator::Generate(conformed[i].data(), width, height, components, gammaCorrection,
+                                                MipGenerator::LooksLikeNormalMap(layers[i]));
+        texels[i] = conformed[i].data();
+        mips[i] = &regenerated[i];
+    }
+
+    GLenum internalFormat, dataFormat;
+    UncompressedFormats(components, gammaCorrection, internalFormat, dataFormat);
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    int levels = 1 + (int)mips[0]->levels.size();
+    for (int level = 0; level < levels; level++)
+    {
+        int w = level == 0 ? width : mips[0]->levels[level - 1].width;
+        int h = level == 0 ? height : mips[0]->levels[level - 1].height;
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, w, h, layers.size(), 0, dataFormat, GL_UNSIGNED_BYTE, nullptr);
+        for (size_t layer = 0; layer < layers.size(); layer++)
+        {
+            const unsigned char *data = level == 0 ? texels[layer] : mips[layer]->data.data() + mips[layer]->levels[level - 1].offset;
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, w, h, 1, dataFormat, GL_UNSIGNED_BYTE, data);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    TextureStats::Get().Record(UncompressedFormatName(components, gammaCorrection),
+                               (size_t)width * height * components * layers.size() * 4 / 3, timer.ElapsedMs());
+
+    TextureRegistry::Get().Insert(TextureArrayKey(layers, gammaCorrection), textureID);
+    return textureID;
+}
+
+#endif
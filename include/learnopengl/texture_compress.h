@@ -0,0 +1,558 @@
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// S3TC formats are an extension on desktop GL and not part of the glad profile
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT        0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT       0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT       0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// Block-compressed texture with a full mip chain, as stored in a KTX 1.1 file.
+// BC1 (opaque colour), BC3 (colour + alpha), BC4 (single channel) and BC5 (two channel normal maps).
+struct CompressedTexture
+{
+    struct Level {
+        int width;
+        int height;
+        size_t offset;  // into data
+        size_t size;
+    };
+    GLenum internalFormat = 0;
+    GLenum baseFormat = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<Level> levels;
+    std::vector<unsigned char> data;
+
+    size_t ByteSize() const { return data.size(); }
+};
+
+namespace TextureCompression {
+
+    enum Format {
+        BC1,
+        BC3,
+        BC4,
+        BC5
+    };
+
+    inline const char *FormatName(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT: return "BC1";
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT: return "BC3";
+            case GL_COMPRESSED_RED_RGTC1: return "BC4";
+            case GL_COMPRESSED_RG_RGTC2: return "BC5";
+        }
+        return "uncompressed";
+    }
+
+    inline size_t BlockBytes(Format format)
+    {
+        return format == BC1 || format == BC4 ? 8 : 16;
+    }
+
+    // bytes per 4x4 block of a GL internal format, 0 for formats we don't handle
+    inline size_t BlockBytes(GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_RED_RGTC1: return 8;
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+            case GL_COMPRESSED_RG_RGTC2: return 16;
+        }
+        return 0;
+    }
+
+    // the same block data read as sRGB or linear, depending on what the caller asked for
+    inline GLenum WithColorSpace(GLenum internalFormat, bool srgb)
+    {
+        switch (internalFormat)
+        {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+                return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+                return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        }
+        return internalFormat;
+    }
+
+    // ------------------------------------------------------------------------
+    // block encoders, each takes 16 RGBA texels in row-major order
+    // ------------------------------------------------------------------------
+
+    inline uint16_t packRGB565(const float c[3])
+    {
+        int r = std::min(31, std::max(0, (int)std::lround(c[0] * 31.0f / 255.0f)));
+        int g = std::min(63, std::max(0, (int)std::lround(c[1] * 63.0f / 255.0f)));
+        int b = std::min(31, std::max(0, (int)std::lround(c[2] * 31.0f / 255.0f)));
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    inline void unpackRGB565(uint16_t v, float c[3])
+    {
+        int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+        c[0] = (float)((r << 3) | (r >> 2));
+        c[1] = (float)((g << 2) | (g >> 4));
+        c[2] = (float)((b << 3) | (b >> 2));
+    }
+
+    // picks the nearest palette entry per texel for the given endpoints, returns the squared error
+    inline float fitBC1Indices(const unsigned char texels[16][4], uint16_t c0, uint16_t c1, uint32_t &indices)
+    {
+        float palette[4][3];
+        unpackRGB565(c0, palette[0]);
+        unpackRGB565(c1, palette[1]);
+        for (int k = 0; k < 3; k++)
+        {
+            palette[2][k] = (2.0f * palette[0][k] + palette[1][k]) / 3.0f;
+            palette[3][k] = (palette[0][k] + 2.0f * palette[1][k]) / 3.0f;
+        }
+        float error = 0.0f;
+        indices = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            int best = 0;
+            float bestDistance = 1e30f;
+            for (int p = 0; p < (c0 == c1 ? 1 : 4); p++)
+            {
+                float d = 0.0f;
+                for (int k = 0; k < 3; k++)
+                {
+                    float diff = texels[i][k] - palette[p][k];
+                    d += diff * diff;
+                }
+                if (d < bestDistance)
+                {
+                    bestDistance = d;
+                    best = p;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+            error += bestDistance;
+        }
+        return error;
+    }
+
+    inline void writeBC1Block(uint16_t c0, uint16_t c1, uint32_t indices, unsigned char *out)
+    {
+        out[0] = c0 & 0xFF; out[1] = c0 >> 8;
+        out[2] = c1 & 0xFF; out[3] = c1 >> 8;
+        for (int i = 0; i < 4; i++)
+            out[4 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+
+    // endpoints along the principal axis of the block's colours, refined once by a least-squares fit
+    inline void EncodeBC1Block(const unsigned char texels[16][4], unsigned char *out)
+    {
+        float mean[3] = {0, 0, 0};
+        for (int i = 0; i < 16; i++)
+            for (int k = 0; k < 3; k++)
+                mean[k] += texels[i][k] / 16.0f;
+        float cov[6] = {0, 0, 0, 0, 0, 0};
+        for (int i = 0; i < 16; i++)
+        {
+            float d[3] = { texels[i][0] - mean[0], texels[i][1] - mean[1], texels[i][2] - mean[2] };
+            cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+            cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+        }
+        // power iteration for the dominant eigenvector
+        float axis[3] = {1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+            float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+            float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+            float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+            if (length < 1e-6f)
+                break;
+            axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+        }
+        float minT = 1e30f, maxT = -1e30f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = (texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] + (texels[i][2] - mean[2]) * axis[2];
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+        float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        float e0[3], e1[3];
+        for (int k = 0; k < 3; k++)
+        {
+            e0[k] = mean[k] + axis[k] * maxT / std::max(axisLength2, 1e-6f);
+            e1[k] = mean[k] + axis[k] * minT / std::max(axisLength2, 1e-6f);
+        }
+
+        uint16_t c0 = packRGB565(e0), c1 = packRGB565(e1);
+        if (c0 < c1)
+            std::swap(c0, c1);
+        uint32_t indices;
+        float error = fitBC1Indices(texels, c0, c1, indices);
+
+        // least-squares endpoints for the chosen indices
+        if (c0 != c1)
+        {
+            static const float weights[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+            float aa = 0, bb = 0, ab = 0, ax[3] = {0, 0, 0}, bx[3] = {0, 0, 0};
+            for (int i = 0; i < 16; i++)
+            {
+                float a = weights[(indices >> (2 * i)) & 3], b = 1.0f - a;
+                aa += a * a; bb += b * b; ab += a * b;
+                for (int k = 0; k < 3; k++)
+                {
+                    ax[k] += a * texels[i][k];
+                    bx[k] += b * texels[i][k];
+                }
+            }
+            float det = aa * bb - ab * ab;
+            if (std::fabs(det) > 1e-6f)
+            {
+                float r0[3], r1[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    r0[k] = (ax[k] * bb - bx[k] * ab) / det;
+                    r1[k] = (bx[k] * aa - ax[k] * ab) / det;
+                }
+                uint16_t d0 = packRGB565(r0), d1 = packRGB565(r1);
+                if (d0 < d1)
+                    std::swap(d0, d1);
+                uint32_t refined;
+                float refinedError = fitBC1Indices(texels, d0, d1, refined);
+                if (refinedError < error)
+                {
+                    c0 = d0; c1 = d1; indices = refined;
+                }
+            }
+        }
+        writeBC1Block(c0, c1, indices, out);
+    }
+
+    // 8-value interpolated block used for BC4/BC5 channels and BC3 alpha
+    inline void EncodeBC4Block(const unsigned char values[16], unsigned char *out)
+    {
+        unsigned char lo = 255, hi = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            lo = std::min(lo, values[i]);
+            hi = std::max(hi, values[i]);
+        }
+        out[0] = hi;
+        out[1] = lo;
+        float palette[8];
+        palette[0] = hi;
+        palette[1] = lo;
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * hi + i * lo) / 7.0f;
+
+        uint64_t bits = 0;
+        for (int i = 0; i < 16 && hi != lo; i++)
+        {
+            int best = 0;
+            float bestDistance = 1e30f;
+            for (int p = 0; p < 8; p++)
+            {
+                float d = std::fabs(values[i] - palette[p]);
+                if (d < bestDistance)
+                {
+                    bestDistance = d;
+                    best = p;
+                }
+            }
+            bits |= (uint64_t)best << (3 * i);
+        }
+        for (int i = 0; i < 6; i++)
+            out[2 + i] = (bits >> (8 * i)) & 0xFF;
+    }
+
+    inline void EncodeBlock(Format format, const unsigned char texels[16][4], unsigned char *out)
+    {
+        unsigned char channel[16];
+        switch (format)
+        {
+            case BC1:
+                EncodeBC1Block(texels, out);
+                break;
+            case BC3:
+                for (int i = 0; i < 16; i++)
+                    channel[i] = texels[i][3];
+                EncodeBC4Block(channel, out);
+                EncodeBC1Block(texels, out + 8);
+                break;
+            case BC4:
+                for (int i = 0; i < 16; i++)
+                    channel[i] = texels[i][0];
+                EncodeBC4Block(channel, out);
+                break;
+            case BC5:
+                for (int c = 0; c < 2; c++)
+                {
+                    for (int i = 0; i < 16; i++)
+                        channel[i] = texels[i][c];
+                    EncodeBC4Block(channel, out + 8 * c);
+                }
+                break;
+        }
+    }
+
+    // compresses one RGBA8 image, edge texels are repeated for partial blocks
+    inline std::vector<unsigned char> EncodeImage(Format format, const unsigned char *rgba, int width, int height)
+    {
+        int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        std::vector<unsigned char> out(blocksX * blocksY * BlockBytes(format));
+        unsigned char texels[16][4];
+        for (int by = 0; by < blocksY; by++)
+        {
+            for (int bx = 0; bx < blocksX; bx++)
+            {
+                for (int i = 0; i < 16; i++)
+                {
+                    int x = std::min(bx * 4 + i % 4, width - 1);
+                    int y = std::min(by * 4 + i / 4, height - 1);
+                    std::memcpy(texels[i], rgba + 4 * ((size_t)y * width + x), 4);
+                }
+                EncodeBlock(format, texels, &out[(by * blocksX + bx) * BlockBytes(format)]);
+            }
+        }
+        return out;
+    }
+
+    inline GLenum InternalFormat(Format format, bool srgb)
+    {
+        switch (format)
+        {
+            case BC1: return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            case BC4: return GL_COMPRESSED_RED_RGTC1;
+            case BC5: return GL_COMPRESSED_RG_RGTC2;
+        }
+        return 0;
+    }
+
+    inline GLenum BaseFormat(Format format)
+    {
+        switch (format)
+        {
+            case BC1: return GL_RGB;
+            case BC3: return GL_RGBA;
+            case BC4: return GL_RED;
+            case BC5: return GL_RG;
+        }
+        return 0;
+    }
+
+    // ------------------------------------------------------------------------
+    // mip chain
+    // ------------------------------------------------------------------------
+
+    inline float srgbToLinear(unsigned char value)
+    {
+        float c = value / 255.0f;
+        return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    inline unsigned char linearToSrgb(float c)
+    {
+        c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        return (unsigned char)std::min(255L, std::max(0L, std::lround(c * 255.0f)));
+    }
+
+    // 2x2 box filter of an RGBA8 image. Colour images are averaged in linear space, and normal maps are
+    // renormalised so that shorter averaged normals don't darken the lighting at a distance.
+    inline std::vector<unsigned char> Downsample(const std::vector<unsigned char> &rgba, int width, int height,
+                                                 bool srgb, bool normalMap)
+    {
+        int w = std::max(1, width / 2), h = std::max(1, height / 2);
+        std::vector<unsigned char> out((size_t)w * h * 4);
+        for (int y = 0; y < h; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                float sum[4] = {0, 0, 0, 0};
+                for (int j = 0; j < 2; j++)
+                {
+                    for (int i = 0; i < 2; i++)
+                    {
+                        int sx = std::min(2 * x + i, width - 1), sy = std::min(2 * y + j, height - 1);
+                        const unsigned char *texel = &rgba[4 * ((size_t)sy * width + sx)];
+                        for (int k = 0; k < 3; k++)
+                            sum[k] += srgb ? srgbToLinear(texel[k]) : texel[k] / 255.0f;
+                        sum[3] += texel[3] / 255.0f;
+                    }
+                }
+                unsigned char *texel = &out[4 * ((size_t)y * w + x)];
+                if (normalMap)
+                {
+                    float n[3] = { sum[0] / 2.0f - 1.0f, sum[1] / 2.0f - 1.0f, sum[2] / 2.0f - 1.0f };
+                    float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    for (int k = 0; k < 3; k++)
+                        sum[k] = length > 1e-6f ? (n[k] / length * 0.5f + 0.5f) * 4.0f : (k == 2 ? 4.0f : 2.0f);
+                }
+                for (int k = 0; k < 4; k++)
+                {
+                    float c = sum[k] / 4.0f;
+                    texel[k] = srgb && k < 3 ? linearToSrgb(c) : (unsigned char)std::lround(std::min(1.0f, std::max(0.0f, c)) * 255.0f);
+                }
+            }
+        }
+        return out;
+    }
+
+    // compresses an RGBA8 image and every level of its mip chain down to 1x1
+    inline CompressedTexture Compress(Format format, std::vector<unsigned char> rgba, int width, int height,
+                                      bool srgb, bool normalMap)
+    {
+        CompressedTexture texture;
+        texture.internalFormat = InternalFormat(format, srgb);
+        texture.baseFormat = BaseFormat(format);
+        texture.width = width;
+        texture.height = height;
+        for (;;)
+        {
+            std::vector<unsigned char> blocks = EncodeImage(format, rgba.data(), width, height);
+            CompressedTexture::Level level;
+            level.width = width;
+            level.height = height;
+            level.offset = texture.data.size();
+            level.size = blocks.size();
+            texture.data.insert(texture.data.end(), blocks.begin(), blocks.end());
+            texture.levels.push_back(level);
+            if (width == 1 && height == 1)
+                break;
+            rgba = Downsample(rgba, width, height, srgb, normalMap);
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        return texture;
+    }
+
+    // ------------------------------------------------------------------------
+    // KTX 1.1 container
+    // ------------------------------------------------------------------------
+
+    static const unsigned char KTXIdentifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    struct KTXHeader {
+        unsigned char identifier[12];
+        uint32_t endianness;
+        uint32_t glType;
+        uint32_t glTypeSize;
+        uint32_t glFormat;
+        uint32_t glInternalFormat;
+        uint32_t glBaseInternalFormat;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t numberOfArrayElements;
+        uint32_t numberOfFaces;
+        uint32_t numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    };
+
+    // the cooked file that replaces an image: "bricks.png" -> "bricks.ktx"
+    inline std::string CookedPath(const std::string &path)
+    {
+        size_t dot = path.find_last_of('.');
+        size_t slash = path.find_last_of('/');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            return path + ".ktx";
+        return path.substr(0, dot) + ".ktx";
+    }
+
+    inline bool WriteKTX(const std::string &path, const CompressedTexture &texture)
+    {
+        KTXHeader header;
+        std::memcpy(header.identifier, KTXIdentifier, sizeof(KTXIdentifier));
+        header.endianness = 0x04030201;
+        header.glType = 0;
+        header.glTypeSize = 1;
+        header.glFormat = 0;
+        header.glInternalFormat = texture.internalFormat;
+        header.glBaseInternalFormat = texture.baseFormat;
+        header.pixelWidth = texture.width;
+        header.pixelHeight = texture.height;
+        header.pixelDepth = 0;
+        header.numberOfArrayElements = 0;
+        header.numberOfFaces = 1;
+        header.numberOfMipmapLevels = texture.levels.size();
+        header.bytesOfKeyValueData = 0;
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        for (const CompressedTexture::Level &level : texture.levels)
+        {
+            // block sizes are multiples of 4 bytes, so no mip padding is needed
+            uint32_t imageSize = level.size;
+            out.write(reinterpret_cast<const char*>(&imageSize), sizeof(imageSize));
+            out.write(reinterpret_cast<const char*>(&texture.data[level.offset]), level.size);
+        }
+        return (bool)out;
+    }
+
+    inline bool ReadKTX(const std::string &path, CompressedTexture &texture)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        KTXHeader header;
+        in.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!in || std::memcmp(header.identifier, KTXIdentifier, sizeof(KTXIdentifier)) != 0
+                || header.endianness != 0x04030201 || header.glType != 0 || header.numberOfFaces != 1
+                || header.numberOfArrayElements != 0 || BlockBytes((GLenum)header.glInternalFormat) == 0)
+            return false;
+        in.seekg(header.bytesOfKeyValueData, std::ios::cur);
+
+        texture.internalFormat = header.glInternalFormat;
+        texture.baseFormat = header.glBaseInternalFormat;
+        texture.width = header.pixelWidth;
+        texture.height = header.pixelHeight;
+        texture.levels.clear();
+        texture.data.clear();
+        int width = texture.width, height = texture.height;
+        for (uint32_t i = 0; i < std::max<uint32_t>(header.numberOfMipmapLevels, 1); i++)
+        {
+            uint32_t imageSize = 0;
+            in.read(reinterpret_cast<char*>(&imageSize), sizeof(imageSize));
+            size_t expected = (size_t)((width + 3) / 4) * ((height + 3) / 4) * BlockBytes((GLenum)texture.internalFormat);
+            if (!in || imageSize != expected)
+                return false;
+            CompressedTexture::Level level;
+            level.width = width;
+            level.height = height;
+            level.offset = texture.data.size();
+            level.size = imageSize;
+            texture.data.resize(level.offset + imageSize);
+            in.read(reinterpret_cast<char*>(&texture.data[level.offset]), imageSize);
+            if (!in)
+                return false;
+            in.seekg((4 - imageSize % 4) % 4, std::ios::cur);
+            texture.levels.push_back(level);
+            width = std::max(1, width / 2);
+            height = std::max(1, height / 2);
+        }
+        return true;
+    }
+}
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef TEXTURE_FEEDBACK_H
+#define TEXTURE_FEEDBACK_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/shader.h>
+#include <learnopengl/texture.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// Finds out which textures are sampled on screen and at which mip level, and feeds that to the
+// TextureResidency so it keeps only the levels that are seen. Every Interval frames the scene is drawn
+// again into a small integer target (1/Divisor of the screen each way) with the feedback shader, which
+// writes per pixel the group of textures the surface samples (see Group()) and the mip level a texture of
+// a single texel would be sampled at there. The target is read into one of Buffers pixel buffers, and a
+// later Collect() takes the result once its fence has signalled, so the pass never stalls on the GPU.
+// Adding log2 of a texture's size to the lowest level seen for its group gives the finest level it needs.
+// GL thread only.
+class TextureFeedback
+{
+public:
+    // the feedback target is this many times smaller than the screen each way
+    static const int Divisor = 8;
+    // frames between feedback passes
+    static const unsigned int Interval = 4;
+    // readbacks that may be in flight
+    static const int Buffers = 3;
+
+    TextureFeedback(int screenWidth, int screenHeight)
+        : width(std::max(1, screenWidth / Divisor)), height(std::max(1, screenHeight / Divisor)), frame(0), next(0),
+          rounds(0), seenTextures(0)
+    {
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glGenRenderbuffers(2, renderbuffers);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RG32UI, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+        glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "Texture feedback framebuffer not complete!" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        glGenBuffers(Buffers, pbos);
+        for (int i = 0; i < Buffers; i++)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)width * height * 2 * sizeof(GLuint), nullptr, GL_STREAM_READ);
+            fences[i] = 0;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    ~TextureFeedback()
+    {
+        for (int i = 0; i < Buffers; i++)
+            if (fences[i])
+                glDeleteSync(fences[i]);
+        glDeleteBuffers(Buffers, pbos);
+        glDeleteRenderbuffers(2, renderbuffers);
+        glDeleteFramebuffers(1, &fbo);
+    }
+    TextureFeedback(const TextureFeedback&) = delete;
+    TextureFeedback& operator=(const TextureFeedback&) = delete;
+
+    // the id the feedback shader writes for surfaces sampling these textures with the same coordinates,
+    // assigned on first use; 0 is the background and surfaces without streamed textures
+    static unsigned int Group(const std::vector<unsigned int> &textures)
+    {
+        if (textures.empty())
+            return 0;
+        std::map<std::vector<unsigned int>, unsigned int> &ids = groupIds();
+        auto it = ids.find(textures);
+        if (it != ids.end())
+            return it->second;
+        groups().push_back(textures);
+        return ids[textures] = groups().size();
+    }
+
+    // sets the feedbackGroup uniform of the bound feedback shader
+    static void SetGroup(const Shader &shader, const std::vector<unsigned int> &textures)
+    {
+        glUniform1ui(shader.Location("feedbackGroup"), Group(textures));
+    }
+
+    // call once per frame. On frames with a pass due (and a buffer free for it) binds the feedback target
+    // and the shader, which then still needs its model matrix, and returns true: draw the
+    // textured scene and call End(). Otherwise returns false.
+    bool Begin(Shader &shader)
+    {
+        if (frame++ % Interval != 0 || fences[next])
+            return false;
+        glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glViewport(0, 0, width, height);
+        const GLuint background[4] = { 0, 0, 0, 0 };
+        glClearBufferuiv(GL_COLOR, 0, background);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        shader.use();
+        // derivatives across a feedback pixel span Divisor screen pixels
+        shader.setFloat("lodBias", -std::log2((float)Divisor));
+        return true;
+    }
+
+    // starts reading back the pass Begin() set up and restores the framebuffer and viewport
+    void End()
+    {
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[next]);
+        glReadPixels(0, 0, width, height, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        next = (next + 1) % Buffers;
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    }
+
+    // hands the oldest readback that has arrived to the TextureResidency: every texture of a group that
+    // was seen gets the finest level it was sampled at requested, the ones of groups not seen at all
+    // their coarsest. Returns whether there was one.
+    bool Collect()
+    {
+        int oldest = next;
+        for (int i = 0; i < Buffers && !fences[oldest]; i++)
+            oldest = (oldest + 1) % Buffers;
+        if (!fences[oldest])
+            return false;
+        GLenum status = glClientWaitSync(fences[oldest], 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return false;
+        glDeleteSync(fences[oldest]);
+        fences[oldest] = 0;
+
+        // lowest encoded level per group
+        std::vector<GLuint> lowest(groups().size() + 1, UINT32_MAX);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[oldest]);
+        size_t pixels = (size_t)width * height;
+        const GLuint *texels = (const GLuint*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixels * 2 * sizeof(GLuint),
+                                                               GL_MAP_READ_BIT);
+        if (texels)
+        {
+            for (size_t i = 0; i < pixels; i++)
+            {
+                GLuint group = texels[2 * i];
+                if (group > 0 && group < lowest.size())
+                    lowest[group] = std::min(lowest[group], texels[2 * i + 1]);
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (!texels)
+            return false;
+
+        // finest level per texture over the groups it is in
+        std::unordered_map<unsigned int, int> levels;
+        TextureResidency &residency = TextureResidency::Get();
+        for (size_t group = 1; group < lowest.size(); group++)
+        {
+            for (unsigned int texture : groups()[group - 1])
+            {
+                int level = INT_MAX;
+                int size = residency.FullSize(texture);
+                if (lowest[group] != UINT32_MAX && size > 0)
+                    level = (int)std::floor(decodeLod(lowest[group]) + std::log2((float)size));
+                auto it = levels.find(texture);
+                if (it == levels.end())
+                    levels[texture] = level;
+                else
+                    it->second = std::min(it->second, level);
+            }
+        }
+        seenTextures = 0;
+        for (const auto &level : levels)
+        {
+            residency.RequestLevel(level.first, level.second);
+            seenTextures += level.second != INT_MAX;
+        }
+        rounds++;
+        return true;
+    }
+
+    size_t Rounds() const { return rounds; }
+    // textures the last collected pass saw on screen
+    size_t SeenTextures() const { return seenTextures; }
+
+private:
+    unsigned int fbo;
+    unsigned int renderbuffers[2];     // colour, depth
+    unsigned int pbos[Buffers];
+    GLsync fences[Buffers];            // of the readback into each buffer, 0 when it is free
+    int width, height;
+    uint64_t frame;
+    int next;                          // buffer the next pass reads into
+    GLint previousFramebuffer;
+    GLint previousViewport[4];
+    size_t rounds;
+    size_t seenTextures;
+
+    // feedback.fs stores the level in 1/256 steps, offset by 32 to stay positive
+    static float decodeLod(GLuint encoded)
+    {
+        return encoded / 256.0f - 32.0f;
+    }
+
+    static std::vector<std::vector<unsigned int>> &groups()
+    {
+        static std::vector<std::vector<unsigned int>> textures;
+        return textures;
+    }
+
+    static std::map<std::vector<unsigned int>, unsigned int> &groupIds()
+    {
+        static std::map<std::vector<unsigned int>, unsigned int> ids;
+        return ids;
+    }
+};
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads for CPU-side asset work (decoding, mesh processing).
+// Jobs must not touch OpenGL: all GL calls stay on the thread that owns the context.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned int threadCount = defaultThreadCount()) : stopping(false)
+    {
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // pool shared by all loaders in the process
+    static ThreadPool &Shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    unsigned int Size() const { return workers.size(); }
+
+    // queues a job and returns a future for its result
+    template<typename F>
+    auto Submit(F job) -> std::future<decltype(job())>
+    {
+        typedef decltype(job()) Result;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(job));
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back([task] { (*task)(); });
+        }
+        wakeUp.notify_one();
+        return result;
+    }
+
+    // runs job(i) for every i in [0, count) on the workers and the calling thread, returning once all of
+    // them are done. The caller takes indices too and only waits for ones already running, so this is
+    // safe from inside a job of the same pool: queued helpers that start late find nothing left to do.
+    template<typename F>
+    void ParallelFor(size_t count, F job)
+    {
+        if (count == 0)
+            return;
+        struct Batch {
+            std::function<void(size_t)> job;
+            size_t count;
+            std::atomic<size_t> next;
+            std::atomic<size_t> done;
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+        std::shared_ptr<Batch> batch = std::make_shared<Batch>();
+        batch->job = std::move(job);
+        batch->count = count;
+        batch->next = 0;
+        batch->done = 0;
+        auto work = [batch] {
+            for (size_t i; (i = batch->next++) < batch->count; )
+            {
+                batch->job(i);
+                if (++batch->done == batch->count)
+                {
+                    std::lock_guard<std::mutex> lock(batch->mutex);
+                    batch->finished.notify_all();
+                }
+            }
+        };
+        size_t helpers = std::min<size_t>(workers.size(), count - 1);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < helpers; i++)
+                jobs.push_back(work);
+        }
+        for (size_t i = 0; i < helpers; i++)
+            wakeUp.notify_one();
+        work();
+        std::unique_lock<std::mutex> lock(batch->mutex);
+        batch->finished.wait(lock, [&batch] { return batch->done == batch->count; });
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping;
+
+    static unsigned int defaultThreadCount()
+    {
+        unsigned int n = std::thread::hardware_concurrency();
+        return n > 0 ? n : 1;
+    }
+
+    void workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+};
+
+// Queue that lets workers hand finished results to a single consumer in completion order.
+template<typename T>
+class CompletionQueue
+{
+public:
+    void Push(T item)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            items.push_back(std::move(item));
+        }
+        ready.notify_one();
+    }
+
+    // blocks until an item is available
+    T Pop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock, [this] { return !items.empty(); });
+        T item = std::move(items.front());
+        items.pop_front();
+        return item;
+    }
+
+    // returns false instead of blocking when nothing has finished yet
+    bool TryPop(T &item)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        return true;
+    }
+
+private:
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable ready;
+};
+
+#endif
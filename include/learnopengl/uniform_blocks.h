@@ -0,0 +1,196 @@
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// C++ mirrors of the std140 uniform blocks the shaders share, filled once per frame and uploaded with one
+// glBufferSubData each. Every program that declares a block gets it bound to the block's fixed binding
+// point when it is linked (see Shader), so one buffer serves all of them.
+//
+// The GLSL declarations are repeated in each shader that uses a block and must match the structs here.
+// The static_asserts hold the structs to the std140 offsets; Shader compares the offsets the driver
+// reports for every linked program with Members() and complains about any difference.
+namespace UniformBlocks {
+
+    enum Binding {
+        CAMERA_BINDING = 0,
+        LIGHTS_BINDING = 1
+    };
+
+    static const int MaxPointLights = 10;
+
+    // GLSL: layout (std140) uniform Camera { mat4 projection; mat4 view; vec3 viewPos; };
+    struct Camera {
+        glm::mat4 projection;
+        glm::mat4 view;
+        glm::vec3 viewPos;
+        float padding;
+    };
+
+    // vec3s are 16 byte aligned in std140, each one is followed by a float member or padding
+    struct PointLight {
+        glm::vec3 position;
+        float constant;
+        glm::vec3 ambient;
+        float linear;
+        glm::vec3 diffuse;
+        float quadratic;
+        glm::vec3 specular;
+        float padding;
+    };
+
+    struct SpotLight {
+        glm::vec3 position;
+        float constant;
+        glm::vec3 direction;
+        float linear;
+        glm::vec3 ambient;
+        float quadratic;
+        glm::vec3 diffuse;
+        float cutOff;
+        glm::vec3 specular;
+        float outerCutOff;
+    };
+
+    struct DirLight {
+        glm::vec3 direction;
+        float padding0;
+        glm::vec3 ambient;
+        float padding1;
+        glm::vec3 diffuse;
+        float padding2;
+        glm::vec3 specular;
+        float padding3;
+    };
+
+    // GLSL: layout (std140) uniform Lights { PointLight pointLight; SpotLight spotLight; DirLight dirLight;
+    //                                         PointLight pointLights[10]; vec3 pointLightColor; int pointLightsSize; };
+    struct Lights {
+        PointLight pointLight;
+        SpotLight spotLight;
+        DirLight dirLight;
+        PointLight pointLights[MaxPointLights];
+        glm::vec3 pointLightColor;
+        int pointLightsSize;
+    };
+
+    static_assert(sizeof(glm::vec3) == 12 && sizeof(glm::mat4) == 64, "glm types must be tightly packed");
+    static_assert(offsetof(Camera, view) == 64 && offsetof(Camera, viewPos) == 128 && sizeof(Camera) == 144,
+                  "Camera does not follow std140");
+    static_assert(offsetof(PointLight, ambient) == 16 && offsetof(PointLight, diffuse) == 32
+                  && offsetof(PointLight, specular) == 48 && sizeof(PointLight) == 64, "PointLight does not follow std140");
+    static_assert(offsetof(SpotLight, direction) == 16 && offsetof(SpotLight, ambient) == 32
+                  && offsetof(SpotLight, diffuse) == 48 && offsetof(SpotLight, specular) == 64 && sizeof(SpotLight) == 80,
+                  "SpotLight does not follow std140");
+    static_assert(offsetof(DirLight, ambient) == 16 && offsetof(DirLight, diffuse) == 32
+                  && offsetof(DirLight, specular) == 48 && sizeof(DirLight) == 64, "DirLight does not follow std140");
+    static_assert(offsetof(Lights, spotLight) == 64 && offsetof(Lights, dirLight) == 144
+                  && offsetof(Lights, pointLights) == 208 && offsetof(Lights, pointLightColor) == 848
+                  && offsetof(Lights, pointLightsSize) == 860 && sizeof(Lights) == 864, "Lights does not follow std140");
+
+    // a block member as GL names it and where the C++ mirror keeps it
+    struct Member {
+        std::string name;
+        size_t offset;
+    };
+
+    inline void addPointLight(std::vector<Member> &members, const std::string &name, size_t offset)
+    {
+        members.push_back({name + ".position", offset + offsetof(PointLight, position)});
+        members.push_back({name + ".constant", offset + offsetof(PointLight, constant)});
+        members.push_back({name + ".ambient", offset + offsetof(PointLight, ambient)});
+        members.push_back({name + ".linear", offset + offsetof(PointLight, linear)});
+        members.push_back({name + ".diffuse", offset + offsetof(PointLight, diffuse)});
+        members.push_back({name + ".quadratic", offset + offsetof(PointLight, quadratic)});
+        members.push_back({name + ".specular", offset + offsetof(PointLight, specular)});
+    }
+
+    // binding point of a block by its GLSL name, -1 for blocks not declared here
+    inline int BindingOf(const std::string &block)
+    {
+        if (block == "Camera")
+            return CAMERA_BINDING;
+        if (block == "Lights")
+            return LIGHTS_BINDING;
+        return -1;
+    }
+
+    inline size_t SizeOf(const std::string &block)
+    {
+        return block == "Camera" ? sizeof(Camera) : block == "Lights" ? sizeof(Lights) : 0;
+    }
+
+    // every member of a block with its offset in the C++ mirror
+    inline std::vector<Member> Members(const std::string &block)
+    {
+        std::vector<Member> members;
+        if (block == "Camera")
+        {
+            members.push_back({"projection", offsetof(Camera, projection)});
+            members.push_back({"view", offsetof(Camera, view)});
+            members.push_back({"viewPos", offsetof(Camera, viewPos)});
+        }
+        else if (block == "Lights")
+        {
+            addPointLight(members, "pointLight", offsetof(Lights, pointLight));
+            const char *spot[] = { "position", "constant", "direction", "linear", "ambient", "quadratic", "diffuse",
+                                   "cutOff", "specular", "outerCutOff" };
+            const size_t spotOffsets[] = { offsetof(SpotLight, position), offsetof(SpotLight, constant),
+                                           offsetof(SpotLight, direction), offsetof(SpotLight, linear),
+                                           offsetof(SpotLight, ambient), offsetof(SpotLight, quadratic),
+                                           offsetof(SpotLight, diffuse), offsetof(SpotLight, cutOff),
+                                           offsetof(SpotLight, specular), offsetof(SpotLight, outerCutOff) };
+            for (size_t i = 0; i < sizeof(spot) / sizeof(spot[0]); i++)
+                members.push_back({std::string("spotLight.") + spot[i], offsetof(Lights, spotLight) + spotOffsets[i]});
+            members.push_back({"dirLight.direction", offsetof(Lights, dirLight) + offsetof(DirLight, direction)});
+            members.push_back({"dirLight.ambient", offsetof(Lights, dirLight) + offsetof(DirLight, ambient)});
+            members.push_back({"dirLight.diffuse", offsetof(Lights, dirLight) + offsetof(DirLight, diffuse)});
+            members.push_back({"dirLight.specular", offsetof(Lights, dirLight) + offsetof(DirLight, specular)});
+            for (int i = 0; i < MaxPointLights; i++)
+                addPointLight(members, "pointLights[" + std::to_string(i) + "]",
+                              offsetof(Lights, pointLights) + i * sizeof(PointLight));
+            members.push_back({"pointLightColor", offsetof(Lights, pointLightColor)});
+            members.push_back({"pointLightsSize", offsetof(Lights, pointLightsSize)});
+        }
+        return members;
+    }
+}
+
+// A uniform buffer holding one Block, bound to its binding point for the whole run. GL thread only.
+template<typename Block>
+class UniformBuffer
+{
+public:
+    explicit UniformBuffer(UniformBlocks::Binding binding)
+    {
+        glGenBuffers(1, &ubo);
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+    }
+    ~UniformBuffer()
+    {
+        glDeleteBuffers(1, &ubo);
+    }
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    // replaces the whole block, every program reading it sees the new values from the next draw on
+    void Upload(const Block &block)
+    {
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(Block), &block);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+private:
+    unsigned int ubo;
+};
+
+#endif
@@ -0,0 +1,19 @@
+#version 330 core
+// texture feedback pass (include/learnopengl/texture_feedback.h): the group of textures this surface
+// samples and the mip level a texture of a single texel would be sampled at, in 1/256 steps offset by 32
+layout (location = 0) out uvec2 Feedback;
+
+in vec2 TexCoords;
+
+uniform uint feedbackGroup;
+// corrects the derivatives of the low resolution target to screen pixels
+uniform float lodBias;
+
+void main()
+{
+    vec2 dx = dFdx(TexCoords);
+    vec2 dy = dFdy(TexCoords);
+    float rho = max(dot(dx, dx), dot(dy, dy));
+    float lod = 0.5 * log2(max(rho, 1e-20)) + lodBias;
+    Feedback = uvec2(feedbackGroup, uint(clamp(lod + 32.0, 0.0, 64.0) * 256.0));
+}
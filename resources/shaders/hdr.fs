@@ -1,20 +1,24 @@
 #version 330 core
+// bloom compiled in or out, chosen per variant by ShaderVariants (include/learnopengl/shader_variants.h)
+#ifndef BLOOM
+#define BLOOM 1
+#endif
 out vec4 FragColor;
 
 in vec2 TexCoords;
 
 uniform sampler2D scene;
 uniform sampler2D bloomBlur;
-uniform bool bloom;
 uniform float exposure;
 
 void main()
 {
     const float gamma = 2.2;
     vec3 hdrColor = texture(scene, TexCoords).rgb;
+#if BLOOM
     vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
-    if(bloom)
-        hdrColor += bloomColor; // additive blending
+    hdrColor += bloomColor; // additive blending
+#endif
     // tone mapping
     vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
     // also gamma correct while we're at it
@@ -1,4 +1,17 @@
 #version 330 core
+// features compiled in or out, chosen per variant by ShaderVariants (include/learnopengl/shader_variants.h)
+#ifndef BLINN
+#define BLINN 1             // Blinn-Phong specular, Phong when 0
+#endif
+#ifndef PARALLAX
+#define PARALLAX 1          // parallax occlusion mapping with the depth map
+#endif
+#ifndef POINT_LIGHTS
+#define POINT_LIGHTS 10     // pointLights entries the loop is compiled for, up to the size of the array
+#endif
+#ifndef BLOCK_ARRAY
+#define BLOCK_ARRAY 0       // maps from layer blockLayer of the block arrays, from material's own when 0
+#endif
 layout (location = 0) out vec4 FragColor;
 layout (location = 1) out vec4 BrightColor;
 
@@ -20,9 +33,9 @@ struct Material {
     float shininess;
 };
 
+// members are ordered to fill the std140 vec3 padding (UniformBlocks in uniform_blocks.h)
 struct DirLight {
     vec3 direction;
-
     vec3 ambient;
     vec3 diffuse;
     vec3 specular;
@@ -30,44 +43,71 @@ struct DirLight {
 
 struct PointLight {
     vec3 position;
-
     float constant;
-    float linear;
-    float quadratic;
-
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
     float constant;
+    vec3 direction;
     float linear;
-    float quadratic;
-
     vec3 ambient;
+    float quadratic;
     vec3 diffuse;
+    float cutOff;
     vec3 specular;
+    float outerCutOff;
 };
 
+// per-frame camera, shared by every program (UniformBlocks::Camera in uniform_blocks.h)
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+// the light set, updated once per frame
+layout (std140) uniform Lights {
+    PointLight pointLight;
+    SpotLight spotLight;
+    DirLight dirLight;
+    PointLight pointLights[10];
+    vec3 pointLightColor;
+    int pointLightsSize;
+};
 
 uniform Material material;
-uniform bool blinn;
-uniform vec3 viewPos;
 
-uniform PointLight pointLight;
-uniform SpotLight spotLight;
-uniform DirLight dirLight;
 uniform float heightScale;
 
-uniform PointLight pointLights[10];
-uniform int pointLightsSize;
-uniform vec3 pointLightColor;
+#if BLOCK_ARRAY
+// the block materials, one layer per block type, on texture units 4 to 7
+struct BlockMaterial {
+    sampler2DArray diffuse;
+    sampler2DArray specular;
+    sampler2DArray normal;
+    sampler2DArray depth;
+};
+
+uniform BlockMaterial blocks;
+// layer of the block type being drawn
+uniform int blockLayer;
+
+vec4 diffuseMap(vec2 texCoords) { return texture(blocks.diffuse, vec3(texCoords, blockLayer)); }
+vec4 specularMap(vec2 texCoords) { return texture(blocks.specular, vec3(texCoords, blockLayer)); }
+vec4 normalMap(vec2 texCoords) { return texture(blocks.normal, vec3(texCoords, blockLayer)); }
+float depthMap(vec2 texCoords) { return texture(blocks.depth, vec3(texCoords, blockLayer)).r; }
+#else
+vec4 diffuseMap(vec2 texCoords) { return texture(material.texture_diffuse, texCoords); }
+vec4 specularMap(vec2 texCoords) { return texture(material.texture_specular, texCoords); }
+vec4 normalMap(vec2 texCoords) { return texture(material.texture_normal, texCoords); }
+float depthMap(vec2 texCoords) { return texture(material.texture_depth, texCoords).r; }
+#endif
 
 // function prototypes
 vec4 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec2 texCoords);
@@ -90,14 +130,14 @@ vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
 
     // get initial values
     vec2  currentTexCoords     = texCoords;
-    float currentDepthMapValue = texture(material.texture_depth, currentTexCoords).r;
+    float currentDepthMapValue = depthMap(currentTexCoords);
 
     while(currentLayerDepth < currentDepthMapValue)
     {
         // shift texture coordinates along direction of P
         currentTexCoords -= deltaTexCoords;
         // get depthmap value at current texture coordinates
-        currentDepthMapValue = texture(material.texture_depth, currentTexCoords).r;
+        currentDepthMapValue = depthMap(currentTexCoords);
         // get depth of next layer
         currentLayerDepth += layerDepth;
     }
@@ -107,7 +147,7 @@ vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
 
     // get depth after and before collision for linear interpolation
     float afterDepth  = currentDepthMapValue - currentLayerDepth;
-    float beforeDepth = texture(material.texture_depth, prevTexCoords).r - currentLayerDepth + layerDepth;
+    float beforeDepth = depthMap(prevTexCoords) - currentLayerDepth + layerDepth;
 
     // interpolation of texture coordinates
     float weight = afterDepth / (afterDepth - beforeDepth);
@@ -120,14 +160,18 @@ void main()
 {   vec3 viewDir = normalize(fs_in.TangentViewPos - fs_in.TangentFragPos);
 
     vec2 texCoords = fs_in.TexCoords;
+#if PARALLAX
     texCoords = ParallaxMapping(fs_in.TexCoords,  viewDir);
     if(texCoords.x > 1.0 || texCoords.y > 1.0 || texCoords.x < 0.0 || texCoords.y < 0.0)
         discard;
+#endif
 
     // obtain normal from normal map in range [0,1]
-    vec3 norm = texture(material.texture_normal, texCoords).rgb;
+    // only x and y are read: two channel (BC5) maps carry no z, which follows from the normal being unit length
+    vec2 normXY = normalMap(texCoords).rg;
     // transform normal vector to range [-1,1]
-    norm = normalize(norm * 2.0 - 1.0);  // this normal is in tangent space
+    normXY = normXY * 2.0 - 1.0;
+    vec3 norm = normalize(vec3(normXY, sqrt(max(1.0 - dot(normXY, normXY), 0.0))));  // this normal is in tangent space
 
 
 
@@ -138,7 +182,9 @@ void main()
     lighting += CalcPointLight(pointLight, norm,fs_in.FragPos, viewDir, texCoords);
     lighting += CalcSpotLight(spotLight, norm, fs_in.FragPos, viewDir, texCoords);
 
-    for(int i=0; i< pointLightsSize; i++){
+    for(int i=0; i< POINT_LIGHTS; i++){
+        if(i >= pointLightsSize)
+            break;
         result =  CalcPointLight(pointLights[i], norm,fs_in.FragPos, viewDir, texCoords);
         float distance = length(fs_in.FragPos - pointLights[i].position);
         result *= 1.0/ (distance*distance);
@@ -162,23 +208,19 @@ vec4 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec2 texCoords)
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
     float spec = 0;
-    if(blinn)
-    {
-        vec3 halfwayDir = normalize(lightDir + viewDir);
-        spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-    }
-    else
-    {
-        vec3 reflectDir = reflect(-lightDir, normal);
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    }
+#if BLINN
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+#else
+    vec3 reflectDir = reflect(-lightDir, normal);
+    spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+#endif
 
     // combine results
-    vec4 ambient = vec4(light.ambient,1.0) * texture(material.texture_diffuse, texCoords);
-    vec4 diffuse = vec4(light.diffuse * diff,1.0) * texture(material.texture_diffuse, texCoords);
-    vec4 specular = vec4(light.specular * spec,1.0) * texture(material.texture_specular, texCoords);
+    vec4 ambient = vec4(light.ambient,1.0) * diffuseMap(texCoords);
+    vec4 diffuse = vec4(light.diffuse * diff,1.0) * diffuseMap(texCoords);
+    vec4 specular = vec4(light.specular * spec,1.0) * specularMap(texCoords);
     return (ambient + diffuse + specular);
 }
 
@@ -190,23 +232,20 @@ vec4 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, v
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     float spec = 0;
-    if(blinn)
-    {
-        vec3 halfwayDir = normalize(lightDir + viewDir);
-        spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-    }
-    else
-    {
-        vec3 reflectDir = reflect(-lightDir, normal);
-        spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    }
+#if BLINN
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+#else
+    vec3 reflectDir = reflect(-lightDir, normal);
+    spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+#endif
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
     // combine results
-    vec4 ambient = vec4(light.ambient,1.0) * texture(material.texture_diffuse, texCoords);
-    vec4 diffuse = vec4(light.diffuse * diff,1.0) * texture(material.texture_diffuse, texCoords);
-    vec4 specular = vec4(light.specular * spec,1.0) * texture(material.texture_specular, texCoords);
+    vec4 ambient = vec4(light.ambient,1.0) * diffuseMap(texCoords);
+    vec4 diffuse = vec4(light.diffuse * diff,1.0) * diffuseMap(texCoords);
+    vec4 specular = vec4(light.specular * spec,1.0) * specularMap(texCoords);
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -220,18 +259,14 @@ vec4 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
-    vec3 reflectDir = reflect(-lightDir, normal);
     float spec = 0;
-    if(blinn)
-    {
-        vec3 halfwayDir = normalize(lightDir + viewDir);
-        spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
-    }
-    else
-    {
-         vec3 reflectDir = reflect(-lightDir, normal);
-         spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    }
+#if BLINN
+    vec3 halfwayDir = normalize(lightDir + viewDir);
+    spec = pow(max(dot(normal, halfwayDir), 0.0), material.shininess);
+#else
+    vec3 reflectDir = reflect(-lightDir, normal);
+    spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+#endif
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
@@ -240,9 +275,9 @@ vec4 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec4 ambient = vec4(light.ambient,1.0) * texture(material.texture_diffuse, texCoords);
-    vec4 diffuse = vec4(light.diffuse * diff,1.0) * texture(material.texture_diffuse, texCoords);
-    vec4 specular = vec4(light.specular * spec,1.0) * texture(material.texture_specular, texCoords);
+    vec4 ambient = vec4(light.ambient,1.0) * diffuseMap(texCoords);
+    vec4 diffuse = vec4(light.diffuse * diff,1.0) * diffuseMap(texCoords);
+    vec4 specular = vec4(light.specular * spec,1.0) * specularMap(texCoords);
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
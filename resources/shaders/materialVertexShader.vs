@@ -2,8 +2,7 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
+layout (location = 3) in vec4 aTangent; // w: handedness of the bitangent
 
 out VS_OUT {
     vec3 FragPos;
@@ -14,40 +13,55 @@ out VS_OUT {
     vec3 TangentFragPos;
 } vs_out;
 
+// members are ordered to fill the std140 vec3 padding (UniformBlocks in uniform_blocks.h)
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
 struct PointLight {
     vec3 position;
-
     float constant;
-    float linear;
-    float quadratic;
-
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
-    float cutOff;
-    float outerCutOff;
-
     float constant;
+    vec3 direction;
     float linear;
-    float quadratic;
-
     vec3 ambient;
+    float quadratic;
     vec3 diffuse;
+    float cutOff;
     vec3 specular;
+    float outerCutOff;
 };
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+// per-frame camera, shared by every program (UniformBlocks::Camera in uniform_blocks.h)
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
-uniform SpotLight spotLight;
-uniform PointLight pointLight;
-uniform vec3 viewPos;
+// the light set, updated once per frame
+layout (std140) uniform Lights {
+    PointLight pointLight;
+    SpotLight spotLight;
+    DirLight dirLight;
+    PointLight pointLights[10];
+    vec3 pointLightColor;
+    int pointLightsSize;
+};
+
+uniform mat4 model;
 
 void main()
 {
@@ -55,9 +69,10 @@ void main()
     vs_out.TexCoords = aTexCoords;
 
      mat3 normalMatrix = transpose(inverse(mat3(model)));
-     vec3 T = normalize(mat3(model) * aTangent);
-     vec3 B = normalize(mat3(model) * aBitangent);
+     vec3 T = normalize(mat3(model) * aTangent.xyz);
      vec3 N = normalize(mat3(model) * aNormal);
+     // the bitangent is not stored, rebuild it from the normal and tangent
+     vec3 B = cross(N, T) * (aTangent.w < 0.0 ? -1.0 : 1.0);
 
      mat3 TBN = transpose(mat3(T, B, N));
 
@@ -11,8 +11,13 @@
 
 #include <learnopengl/filesystem.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/shader_variants.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/preloader.h>
+#include <learnopengl/render_view.h>
+#include <learnopengl/tangent_space.h>
+#include <learnopengl/texture_feedback.h>
 
 #include <iostream>
 
@@ -26,16 +31,16 @@ void processInput(GLFWwindow *window);
 
 void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
-unsigned int loadTexture(const char *path, bool gammaCorrection);
 
-unsigned int loadCubemap(vector<std::string> faces);
 
 void renderEmptyCube();
 
 void renderQuad();
 void renderHDRQuad();
 
-void renderCube(Shader shader, glm::vec3 center, float a);
+void renderCube(Shader &shader, glm::vec3 center, float a);
+
+glm::mat4 coinTransform(const float coin[3], float time);
 
 // settings
 const unsigned int SCR_WIDTH = 800;
@@ -46,6 +51,8 @@ bool hdrKeyPressed = false;
 bool bloom = true;
 bool bloomKeyPressed = false;
 float exposure = 1.0f;
+// bytes of geometry and texels asynchronously loaded models may upload per frame
+const size_t STREAMING_BUDGET_BYTES = 4 * 1024 * 1024;
 
 // camera
 
@@ -68,6 +75,19 @@ struct PointLight {
     float quadratic;
 };
 
+// a PointLight as the shaders' Lights block stores it
+UniformBlocks::PointLight lightBlock(const PointLight &light) {
+    UniformBlocks::PointLight block = {};
+    block.position = light.position;
+    block.ambient = light.ambient;
+    block.diffuse = light.diffuse;
+    block.specular = light.specular;
+    block.constant = light.constant;
+    block.linear = light.linear;
+    block.quadratic = light.quadratic;
+    return block;
+}
+
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
     bool ImGuiEnabled = false;
@@ -76,6 +96,9 @@ struct ProgramState {
     glm::vec3 backpackPosition = glm::vec3(0.0f);
     float backpackScale = 1.0f;
     PointLight pointLight;
+    int textureBudgetMiB = 256;     // GPU memory textures may take, 0 for no limit
+    bool blinn = true;              // Blinn-Phong specular instead of Phong
+    bool parallax = true;           // parallax occlusion mapping
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 10.0f)) {}
 
@@ -95,7 +118,8 @@ void ProgramState::SaveToFile(std::string filename) {
         << camera.Position.z << '\n'
         << camera.Front.x << '\n'
         << camera.Front.y << '\n'
-        << camera.Front.z << '\n';
+        << camera.Front.z << '\n'
+        << textureBudgetMiB << '\n';
 }
 
 void ProgramState::LoadFromFile(std::string filename) {
@@ -111,6 +135,9 @@ void ProgramState::LoadFromFile(std::string filename) {
            >> camera.Front.x
            >> camera.Front.y
            >> camera.Front.z;
+        // files saved before the budget existed end here
+        if (!(in >> textureBudgetMiB))
+            textureBudgetMiB = 256;
     }
 }
 
@@ -318,6 +345,12 @@ float mysteryCubes[][3] = {
 
 float cubeSize = 2.0f;
 
+// layers of the block material arrays, in the order the manifest lists them
+enum BlockType {
+    BLOCK_BRICK,
+    BLOCK_MYSTERY
+};
+
 float coins[][3] = {
         {22.0f,2.8f,0.0f},
         {26.0f,2.8f,0.0f},
@@ -325,10 +358,15 @@ float coins[][3] = {
         {52.0f,2.8f,0.0f},
         {56.0f,2.8f,0.0f},
 };
+// level of detail each coin was drawn at last frame
+LodState coinLods[sizeof(coins) / sizeof(coins[0])];
 
 ProgramState *programState;
 
-void DrawImGui(ProgramState *programState);
+void DrawImGui(ProgramState *programState, const TextureFeedback &textureFeedback);
+
+// the material shader variant for the current settings and number of coin lights
+ShaderDefines materialDefines(const ProgramState &state, int pointLights, bool blockArray);
 
 int main() {
     // glfw: initialize and configure
@@ -364,6 +402,8 @@ int main() {
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    // extensions the loaders may use beyond core 3.3 (S3TC block compression)
+    GLExtensions::Get().Load();
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     //stbi_set_flip_vertically_on_load(true);
@@ -388,19 +428,30 @@ int main() {
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
+    // the skybox is mipmapped, filter across cubemap face edges
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 
-    // build and compile shaders
+    // load the assets listed in the manifest: file reads, decoding and mesh processing run on the
+    // thread pool while this thread compiles the shaders and uploads the textures as they get ready
     // -------------------------
-    Shader materialShader("resources/shaders/materialVertexShader.vs","resources/shaders/materialFragmentShader.fs");
-    Shader shaderLight("resources/shaders/light.vs","resources/shaders/light.fs");
-    Shader shaderBlur("resources/shaders/blur.vs","resources/shaders/blur.fs");
-    Shader skyboxShader("resources/shaders/skybox.vs", "resources/shaders/skybox.fs");
-    Shader hdrShader("resources/shaders/hdr.vs", "resources/shaders/hdr.fs");
-
-    // load models
+    AssetManifest manifest;
+    manifest.LoadFromFile(FileSystem::getPath("resources/manifest.txt"));
+    AssetSet assets = Preloader::Load(manifest);
+
+    // shaders
+    // picked per frame from the settings, see materialDefines()
+    ShaderVariants &materialVariants = assets.GetVariants("material");
+    Shader &shaderLight = assets.GetShader("light");
+    Shader &shaderBlur = assets.GetShader("blur");
+    Shader &skyboxShader = assets.GetShader("skybox");
+    ShaderVariants &hdrVariants = assets.GetVariants("hdr");
+    Shader &feedbackShader = assets.GetShader("feedback");
+
+    // models
+    // the model draws a placeholder until it is streamed in
     // -----------
-    Model coinModel("resources/objects/mario_coin/Mario_Coin.obj");
-    coinModel.SetShaderTextureNamePrefix("material.");
+    std::unique_ptr<Model> coinModel = assets.TakeModel("coin");
+    coinModel->SetShaderTextureNamePrefix("material.");
 
     //create skybox
     // skybox VAO
@@ -414,27 +465,15 @@ int main() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
 
-    //load textures
+    // textures
     // --------------
-    unsigned int cubeDiffuse = loadTexture(FileSystem::getPath("resources/textures/bricks.png").c_str(),true);
-    unsigned int cubeSpecular = loadTexture(FileSystem::getPath("resources/textures/bricksSpecular.png").c_str(),false);
-    unsigned int cubeNormal = loadTexture(FileSystem::getPath("resources/textures/bricksNormal.png").c_str(),false);
-    unsigned int cubeDisp = loadTexture(FileSystem::getPath("resources/textures/bricksDisplacement.png").c_str(),false);
-    unsigned int mysteryDiffuse = loadTexture(FileSystem::getPath("resources/textures/mystery.png").c_str(),true);
-    unsigned int mysterySpecular = loadTexture(FileSystem::getPath("resources/textures/mystery_specular.png").c_str(),false);
-    unsigned int mysteryNormal = loadTexture(FileSystem::getPath("resources/textures/mystery_normal.png").c_str(),false);
-    unsigned int mysteryDisp= loadTexture(FileSystem::getPath("resources/textures/mystery_displacement.png").c_str(),false);
-
-    vector<std::string> faces
-            {
-                    FileSystem::getPath("resources/textures/skybox/front5.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/front5.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/top5.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/bottom6.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/front5.jpg"),
-                    FileSystem::getPath("resources/textures/skybox/front5.jpg")
-            };
-    unsigned int cubemapTexture = loadCubemap(faces);
+    // block materials: texture arrays with a layer per BlockType
+    unsigned int blockDiffuse = assets.GetTexture("blockDiffuse");
+    unsigned int blockSpecular = assets.GetTexture("blockSpecular");
+    unsigned int blockNormal = assets.GetTexture("blockNormal");
+    unsigned int blockDisp = assets.GetTexture("blockDisp");
+    unsigned int cubemapTexture = assets.GetTexture("skybox");
+    TextureStats::Get().Print();
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
 
@@ -462,6 +501,9 @@ int main() {
         tmp.quadratic = 0.032f;
         pointLights.push_back(tmp);
     }
+    // camera and lights for every program, uploaded once per frame
+    UniformBuffer<UniformBlocks::Camera> cameraBuffer(UniformBlocks::CAMERA_BINDING);
+    UniformBuffer<UniformBlocks::Lights> lightsBuffer(UniformBlocks::LIGHTS_BINDING);
     // configure (floating point) framebuffers
     // ---------------------------------------
     unsigned int hdrFBO;
@@ -515,13 +557,12 @@ int main() {
             std::cout << "Framebuffer not complete!" << std::endl;
     }
 
+    // low resolution pass finding out which texture mips are seen, to stream in only those
+    TextureFeedback textureFeedback(SCR_WIDTH, SCR_HEIGHT);
+
     shaderBlur.use();
     shaderBlur.setInt("image", 0);
 
-    hdrShader.use();
-    hdrShader.setInt("scene", 0);
-    hdrShader.setInt("bloomBlur", 1);
-
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
@@ -538,6 +579,12 @@ int main() {
         // -----
         processInput(window);
 
+        // continue uploading models that are still loading
+        Model::StreamPending(STREAMING_BUDGET_BYTES);
+        TextureResidency::Get().SetBudget((size_t)programState->textureBudgetMiB * 1024 * 1024);
+        TextureResidency::Get().BeginFrame();
+        CullStats::Get().Reset();
+
 
         // render
         // ------
@@ -550,56 +597,47 @@ int main() {
         //bind it in frame buffer
         glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        materialShader.use();
-        //pointLight.position = glm::vec3(4.0 * cos(currentFrame), 4.0f, 4.0 * sin(currentFrame));
-        materialShader.setVec3("pointLight.position", pointLight.position);
-        materialShader.setVec3("pointLight.ambient", pointLight.ambient);
-        materialShader.setVec3("pointLight.diffuse", pointLight.diffuse);
-        materialShader.setVec3("pointLight.specular", pointLight.specular);
-        materialShader.setFloat("pointLight.constant", pointLight.constant);
-        materialShader.setFloat("pointLight.linear", pointLight.linear);
-        materialShader.setFloat("pointLight.quadratic", pointLight.quadratic);
-        materialShader.setVec3("viewPos", programState->camera.Position);
-        materialShader.setFloat("material.shininess", 32.0f);
-        materialShader.setBool("blinn",true);
-        materialShader.setFloat("heightScale",heightScale);
-        materialShader.setVec3("pointLightColor", glm::vec3(15, 14, 0));
-
-        materialShader.setInt("pointLightsSize",pointLights.size());
-       for (unsigned int i = 0; i < pointLights.size(); i++)
-       {
-           materialShader.setVec3("pointLights[" + std::to_string(i) + "].position", pointLights[i].position);
-           materialShader.setVec3("pointLights[" + std::to_string(i) + "].ambient", pointLights[i].ambient);
-           materialShader.setVec3("pointLights[" + std::to_string(i) + "].diffuse", pointLights[i].diffuse);
-           materialShader.setVec3("pointLights[" + std::to_string(i) + "].specular", pointLights[i].specular);
-           materialShader.setFloat("pointLights[" + std::to_string(i) + "].constant", pointLights[i].constant);
-           materialShader.setFloat("pointLights[" + std::to_string(i) + "].linear", pointLights[i].linear);
-           materialShader.setFloat("pointLights[" + std::to_string(i) + "].quadratic", pointLights[i].quadratic);
-       }
-
-        glm::vec3 spotLightPos = glm::vec3(5.0f, 20.0f,0.0f);
-        materialShader.setVec3("spotLight.position", spotLightPos);
-        materialShader.setVec3("spotLight.direction", glm::vec3(-5.0f));
-        materialShader.setVec3("spotLight.ambient", glm::vec3(0.4f,0.4f,0.4f));
-        materialShader.setVec3("spotLight.diffuse", glm::vec3(1.0f,1.0f,1.0f));
-        materialShader.setVec3("spotLight.specular", glm::vec3(1.0f,1.0f,1.0f));
-        materialShader.setFloat("spotLight.constant", pointLight.constant);
-        materialShader.setFloat("spotLight.linear", pointLight.linear);
-        materialShader.setFloat("spotLight.quadratic", pointLight.quadratic);
-        materialShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.0f)));
-        materialShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-
-        materialShader.setVec3("dirLight.direction", glm::vec3(0.0f,-1.0f,0.0f));
-        materialShader.setVec3("dirLight.ambient", glm::vec3(0.1f,0.1f,0.1f));
-        materialShader.setVec3("dirLight.diffuse", glm::vec3(0.5f,0.3f,0.3f));
-        materialShader.setVec3("dirLight.specular", glm::vec3(0.2f,0.2f,0.2f));
-
         // view/projection transformations
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
                                                  (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = programState->camera.GetViewMatrix();
-        materialShader.setMat4("projection", projection);
-        materialShader.setMat4("view", view);
+        RenderView renderView(programState->camera.Position, programState->camera.Zoom, (float) SCR_HEIGHT,
+                              projection * view);
+        UniformBlocks::Camera camera = {};
+        camera.projection = projection;
+        camera.view = view;
+        camera.viewPos = programState->camera.Position;
+        cameraBuffer.Upload(camera);
+
+        UniformBlocks::Lights lights = {};
+        //pointLight.position = glm::vec3(4.0 * cos(currentFrame), 4.0f, 4.0 * sin(currentFrame));
+        lights.pointLight = lightBlock(pointLight);
+        lights.pointLightColor = glm::vec3(15, 14, 0);
+        lights.pointLightsSize = std::min((int)pointLights.size(), UniformBlocks::MaxPointLights);
+        for (int i = 0; i < lights.pointLightsSize; i++)
+            lights.pointLights[i] = lightBlock(pointLights[i]);
+
+        lights.spotLight.position = glm::vec3(5.0f, 20.0f,0.0f);
+        lights.spotLight.direction = glm::vec3(-5.0f);
+        lights.spotLight.ambient = glm::vec3(0.4f,0.4f,0.4f);
+        lights.spotLight.diffuse = glm::vec3(1.0f,1.0f,1.0f);
+        lights.spotLight.specular = glm::vec3(1.0f,1.0f,1.0f);
+        lights.spotLight.constant = pointLight.constant;
+        lights.spotLight.linear = pointLight.linear;
+        lights.spotLight.quadratic = pointLight.quadratic;
+        lights.spotLight.cutOff = glm::cos(glm::radians(12.0f));
+        lights.spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+
+        lights.dirLight.direction = glm::vec3(0.0f,-1.0f,0.0f);
+        lights.dirLight.ambient = glm::vec3(0.1f,0.1f,0.1f);
+        lights.dirLight.diffuse = glm::vec3(0.5f,0.3f,0.3f);
+        lights.dirLight.specular = glm::vec3(0.2f,0.2f,0.2f);
+        lightsBuffer.Upload(lights);
+
+        Shader &materialShader = materialVariants.Get(materialDefines(*programState, lights.pointLightsSize, false));
+        materialShader.use();
+        materialShader.setFloat("material.shininess", 32.0f);
+        materialShader.setFloat("heightScale",heightScale);
 
         // render the loaded model
         glm::mat4 model = glm::mat4(1.0f);
@@ -611,39 +649,37 @@ int main() {
         materialShader.setInt("material.texture_specular", 1);
         materialShader.setInt("material.texture_normal", 2);
         materialShader.setInt("material.texture_depth", 3);
-        // bind diffuse map
+
+        // the blocks sample their layer of the block materials instead, in a variant of their own
+        Shader &blockShader = materialVariants.Get(materialDefines(*programState, lights.pointLightsSize, true));
+        blockShader.use();
+        blockShader.setFloat("material.shininess", 32.0f);
+        blockShader.setFloat("heightScale",heightScale);
+        blockShader.setInt("blocks.diffuse", 4);
+        blockShader.setInt("blocks.specular", 5);
+        blockShader.setInt("blocks.normal", 6);
+        blockShader.setInt("blocks.depth", 7);
+        // bind the block materials once, every block type is a layer of them
+        glActiveTexture(GL_TEXTURE4);
+        BindTexture(GL_TEXTURE_2D_ARRAY, blockDiffuse);
+        glActiveTexture(GL_TEXTURE5);
+        BindTexture(GL_TEXTURE_2D_ARRAY, blockSpecular);
+        glActiveTexture(GL_TEXTURE6);
+        BindTexture(GL_TEXTURE_2D_ARRAY, blockNormal);
+        glActiveTexture(GL_TEXTURE7);
+        BindTexture(GL_TEXTURE_2D_ARRAY, blockDisp);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeDiffuse);
-        // bind specular map
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, cubeSpecular);
-        // bind normal map
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, cubeNormal);
-        // bind displacment map
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, cubeDisp);
 
+        blockShader.setInt("blockLayer", BLOCK_BRICK);
         for(auto cube:cubes){
-            renderCube(materialShader,glm::vec3(cube[0],cube[1],cube[2]),cubeSize);
+            renderCube(blockShader,glm::vec3(cube[0],cube[1],cube[2]),cubeSize);
         }
 
-        // bind diffuse map
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, mysteryDiffuse);
-        // bind specular map
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, mysterySpecular);
-        // bind normal map
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, mysteryNormal);
-        // bind displacment map
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, mysteryDisp);
-
+        blockShader.setInt("blockLayer", BLOCK_MYSTERY);
         for(auto cube:mysteryCubes){
-            renderCube(materialShader,glm::vec3(cube[0],cube[1],cube[2]),cubeSize);
+            renderCube(blockShader,glm::vec3(cube[0],cube[1],cube[2]),cubeSize);
         }
+        // the coins have textures of their own and are drawn with materialShader
 
         glActiveTexture(GL_TEXTURE2);
         glBindTexture(GL_TEXTURE_2D, 0);
@@ -651,39 +687,49 @@ int main() {
         int i=0;
         for(auto coin:coins){
 
-            materialShader.setVec3("pointLights[" + std::to_string(i) + "].position", glm::vec3(coin[0],coin[1],coin[2]));
+            LodState &coinLod = coinLods[i];
             i++;
-            model = glm::mat4(1.0f);
-            model = glm::translate(model,glm::vec3(coin[0],coin[1],coin[2]));
-            model = glm::translate(model, glm::vec3(0, (float)glm::cos(glfwGetTime()) / 3.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(0.1f));
-            model = glm::rotate(model, 5.0f * (float)glfwGetTime(), glm::vec3(0.0f, 1.0f, 0.0f));
+            model = coinTransform(coin, (float)glfwGetTime());
 
             if(bloom) {
                 shaderLight.use();
-                shaderLight.setMat4("projection", projection);
-                shaderLight.setMat4("view", view);
                 shaderLight.setMat4("model", model);
                 shaderLight.setVec3("lightColor", glm::vec3(31, 28, 0));
-                coinModel.Draw(shaderLight);
+                coinModel->Draw(shaderLight, renderView, model, coinLod);
             }else{
                 materialShader.use();
                 materialShader.setMat4("model", model);
-                coinModel.Draw(materialShader);
+                coinModel->Draw(materialShader, renderView, model, coinLod);
             }
         }
 
+        // texture feedback: the textured scene again, recording which mips it samples
+        if (textureFeedback.Begin(feedbackShader)) {
+            // the blocks only hide what is behind them, texture arrays are not streamed
+            TextureFeedback::SetGroup(feedbackShader, {});
+            for(auto cube:cubes){
+                renderCube(feedbackShader,glm::vec3(cube[0],cube[1],cube[2]),cubeSize);
+            }
+            for(auto cube:mysteryCubes){
+                renderCube(feedbackShader,glm::vec3(cube[0],cube[1],cube[2]),cubeSize);
+            }
+            for (unsigned int j = 0; j < sizeof(coins) / sizeof(coins[0]); j++) {
+                model = coinTransform(coins[j], (float)glfwGetTime());
+                feedbackShader.setMat4("model", model);
+                // at the level the main pass picked: no second LOD update or culling count this frame
+                coinModel->Draw(feedbackShader, coinLods[j].level);
+            }
+            textureFeedback.End();
+        }
+        textureFeedback.Collect();
 
         // draw skybox as last
         glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
         skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
         // skybox cube
         glBindVertexArray(skyboxVAO);
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+        BindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
         glDrawArrays(GL_TRIANGLES, 0, 36);
         glBindVertexArray(0);
         glDepthFunc(GL_LESS); // set depth function back to default
@@ -693,7 +739,8 @@ int main() {
        // 2. blur bright fragments with two-pass Gaussian Blur
        // --------------------------------------------------
        bool horizontal = true, first_iteration = true;
-       unsigned int amount = 10;
+       // without bloom the tone mapping variant does not read the blur
+       unsigned int amount = bloom ? 10 : 0;
        shaderBlur.use();
        for (unsigned int i = 0; i < amount; i++)
        {
@@ -710,19 +757,21 @@ int main() {
        // 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
        // --------------------------------------------------------------------------------------------------------------------------
        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+       Shader &hdrShader = hdrVariants.Get(ShaderDefines().Set("BLOOM", bloom));
        hdrShader.use();
+       hdrShader.setInt("scene", 0);
+       hdrShader.setInt("bloomBlur", 1);
        glActiveTexture(GL_TEXTURE0);
        glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
        glActiveTexture(GL_TEXTURE1);
        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-       hdrShader.setInt("bloom", bloom);
        hdrShader.setFloat("exposure", exposure);
        renderHDRQuad();
 
        std::cout << "hdr: " << (hdr ? "on" : "off") << "| exposure: " << exposure << std::endl;
        std::cout << "bloom: " << (bloom ? "on" : "off") << std::endl;
        if (programState->ImGuiEnabled)
-           DrawImGui(programState);
+           DrawImGui(programState, textureFeedback);
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
@@ -730,6 +779,8 @@ int main() {
     }
 
     //programState->SaveToFile("resources/program_state.txt");
+    // models free their buffers and textures, which needs the GL context
+    coinModel.reset();
     delete programState;
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
@@ -813,7 +864,15 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     programState->camera.ProcessMouseScroll(yoffset);
 }
 
-void DrawImGui(ProgramState *programState) {
+ShaderDefines materialDefines(const ProgramState &state, int pointLights, bool blockArray) {
+    return ShaderDefines()
+            .Set("BLOCK_ARRAY", blockArray)
+            .Set("BLINN", state.blinn)
+            .Set("PARALLAX", state.parallax)
+            .Set("POINT_LIGHTS", ShaderDefines::CountBucket(pointLights, UniformBlocks::MaxPointLights));
+}
+
+void DrawImGui(ProgramState *programState, const TextureFeedback &textureFeedback) {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -844,6 +903,39 @@ void DrawImGui(ProgramState *programState) {
         ImGui::End();
     }
 
+    {
+        // each combination is a shader variant, compiled the first time it is picked
+        ImGui::Begin("Shading");
+        ImGui::Checkbox("Blinn-Phong", &programState->blinn);
+        ImGui::Checkbox("Parallax mapping", &programState->parallax);
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Meshlet culling");
+        const CullStats &stats = CullStats::Get();
+        ImGui::Text("Meshlets culled: %zu of %zu", stats.meshletsCulled, stats.meshletsTested);
+        ImGui::Text("Triangles culled: %zu of %zu", stats.trianglesFrustumCulled + stats.trianglesBackfaceCulled,
+                    stats.trianglesTested);
+        ImGui::Text("  outside the frustum: %zu", stats.trianglesFrustumCulled);
+        ImGui::Text("  facing away: %zu", stats.trianglesBackfaceCulled);
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Texture memory");
+        const TextureResidency &residency = TextureResidency::Get();
+        ImGui::SliderInt("Budget (MiB, 0 = none)", &programState->textureBudgetMiB, 0, 1024);
+        ImGui::Text("Resident: %.1f MiB of %.1f MiB at full resolution", residency.ResidentBytes() / (1024.0 * 1024.0),
+                    residency.FullBytes() / (1024.0 * 1024.0));
+        ImGui::Text("Textures: %zu, reduced: %zu", residency.TextureCount(), residency.ReducedCount());
+        ImGui::Text("Mip drops: %zu, reloads: %zu (%zu in flight)", residency.Reductions(), residency.Reloads(),
+                    residency.PendingReloads());
+        ImGui::Text("Feedback passes: %zu, textures on screen: %zu", textureFeedback.Rounds(),
+                    textureFeedback.SeenTextures());
+        ImGui::End();
+    }
+
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
@@ -860,94 +952,7 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
     }
 }
 
-// utility function for loading a 2D texture from file
-// ---------------------------------------------------
-unsigned int loadTexture(char const * path, bool gammaCorrection)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum internalFormat;
-        GLenum dataFormat;
-        if (nrComponents == 1)
-        {
-            internalFormat = dataFormat = GL_RED;
-        }
-        else if (nrComponents == 3)
-        {
-            internalFormat = gammaCorrection ? GL_SRGB : GL_RGB;
-            dataFormat = GL_RGB;
-        }
-        else if (nrComponents == 4)
-        {
-            internalFormat = gammaCorrection ? GL_SRGB_ALPHA : GL_RGBA;
-            dataFormat = GL_RGBA;
-        }
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
-}
-
-// loads a cubemap texture from 6 individual texture faces
-// order:
-// +X (right)
-// -X (left)
-// +Y (top)
-// -Y (bottom)
-// +Z (front)
-// -Z (back)
-// -------------------------------------------------------
-unsigned int loadCubemap(vector<std::string> faces)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
-}
-
-// renders a 1x1 quad in NDC with manually calculated tangent vectors
+// renders a 1x1 quad in NDC with tangent vectors from TangentSpace
 // ------------------------------------------------------------------
 unsigned int quadVAO = 0;
 unsigned int quadVBO;
@@ -955,68 +960,31 @@ void renderQuad()
 {
     if (quadVAO == 0)
     {
-        // positions
-        glm::vec3 pos1(-1.0f,  1.0f, 0.0f);
-        glm::vec3 pos2(-1.0f, -1.0f, 0.0f);
-        glm::vec3 pos3( 1.0f, -1.0f, 0.0f);
-        glm::vec3 pos4( 1.0f,  1.0f, 0.0f);
-        // texture coordinates
-        glm::vec2 uv1(0.0f, 1.0f);
-        glm::vec2 uv2(0.0f, 0.0f);
-        glm::vec2 uv3(1.0f, 0.0f);
-        glm::vec2 uv4(1.0f, 1.0f);
-        // normal vector
-        glm::vec3 nm(0.0f, 0.0f, 1.0f);
-
-        // calculate tangent/bitangent vectors of both triangles
-        glm::vec3 tangent1, bitangent1;
-        glm::vec3 tangent2, bitangent2;
-        // triangle 1
-        // ----------
-        glm::vec3 edge1 = pos2 - pos1;
-        glm::vec3 edge2 = pos3 - pos1;
-        glm::vec2 deltaUV1 = uv2 - uv1;
-        glm::vec2 deltaUV2 = uv3 - uv1;
-
-        float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-        tangent1.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-        tangent1.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-        tangent1.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-
-        bitangent1.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-        bitangent1.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-        bitangent1.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-
-        // triangle 2
-        // ----------
-        edge1 = pos3 - pos1;
-        edge2 = pos4 - pos1;
-        deltaUV1 = uv3 - uv1;
-        deltaUV2 = uv4 - uv1;
-
-        f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-        tangent2.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-        tangent2.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-        tangent2.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-
-
-        bitangent2.x = f * (-deltaUV2.x * edge1.x + deltaUV1.x * edge2.x);
-        bitangent2.y = f * (-deltaUV2.x * edge1.y + deltaUV1.x * edge2.y);
-        bitangent2.z = f * (-deltaUV2.x * edge1.z + deltaUV1.x * edge2.z);
-
+        // positions, normal and texture coordinates of the corners; tangents follow from them
+        vector<Vertex> corners(4);
+        const glm::vec3 positions[4] = { {-1.0f, 1.0f, 0.0f}, {-1.0f, -1.0f, 0.0f}, {1.0f, -1.0f, 0.0f}, {1.0f, 1.0f, 0.0f} };
+        const glm::vec2 uvs[4] = { {0.0f, 1.0f}, {0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f} };
+        for (int i = 0; i < 4; i++)
+        {
+            corners[i].Position = positions[i];
+            corners[i].Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+            corners[i].TexCoords = uvs[i];
+        }
+        vector<unsigned int> triangles = { 0, 1, 2, 0, 2, 3 };
+        TangentSpace::Generate(corners, triangles);
 
-        float quadVertices[] = {
-                // positions            // normal         // texcoords  // tangent                          // bitangent
-                pos1.x, pos1.y, pos1.z, nm.x, nm.y, nm.z, uv1.x, uv1.y, tangent1.x, tangent1.y, tangent1.z, bitangent1.x, bitangent1.y, bitangent1.z,
-                pos2.x, pos2.y, pos2.z, nm.x, nm.y, nm.z, uv2.x, uv2.y, tangent1.x, tangent1.y, tangent1.z, bitangent1.x, bitangent1.y, bitangent1.z,
-                pos3.x, pos3.y, pos3.z, nm.x, nm.y, nm.z, uv3.x, uv3.y, tangent1.x, tangent1.y, tangent1.z, bitangent1.x, bitangent1.y, bitangent1.z,
-
-                pos1.x, pos1.y, pos1.z, nm.x, nm.y, nm.z, uv1.x, uv1.y, tangent2.x, tangent2.y, tangent2.z, bitangent2.x, bitangent2.y, bitangent2.z,
-                pos3.x, pos3.y, pos3.z, nm.x, nm.y, nm.z, uv3.x, uv3.y, tangent2.x, tangent2.y, tangent2.z, bitangent2.x, bitangent2.y, bitangent2.z,
-                pos4.x, pos4.y, pos4.z, nm.x, nm.y, nm.z, uv4.x, uv4.y, tangent2.x, tangent2.y, tangent2.z, bitangent2.x, bitangent2.y, bitangent2.z
-        };
+        float quadVertices[6 * 14];
+        for (int i = 0; i < 6; i++)
+        {
+            const Vertex &v = corners[triangles[i]];
+            const float attributes[14] = {
+                    // positions                        // normal                        // texcoords
+                    v.Position.x, v.Position.y, v.Position.z, v.Normal.x, v.Normal.y, v.Normal.z, v.TexCoords.x, v.TexCoords.y,
+                    // tangent                          // bitangent
+                    v.Tangent.x, v.Tangent.y, v.Tangent.z, v.Bitangent.x, v.Bitangent.y, v.Bitangent.z
+            };
+            std::copy(attributes, attributes + 14, quadVertices + 14 * i);
+        }
         // configure plane VAO
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
@@ -1029,6 +997,8 @@ void renderQuad()
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(3 * sizeof(float)));
         glEnableVertexAttribArray(2);
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(6 * sizeof(float)));
+        // the shader reads the tangent as a vec4 whose w is the bitangent's handedness; w defaults to 1,
+        // which matches this quad's bitangent (cross(normal, tangent))
         glEnableVertexAttribArray(3);
         glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 14 * sizeof(float), (void*)(8 * sizeof(float)));
         glEnableVertexAttribArray(4);
@@ -1144,7 +1114,17 @@ void renderEmptyCube()
 }
 
 
-void renderCube(Shader shader, glm::vec3 center, float a){
+// model matrix of a coin bobbing and spinning in place
+glm::mat4 coinTransform(const float coin[3], float time){
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model,glm::vec3(coin[0],coin[1],coin[2]));
+    model = glm::translate(model, glm::vec3(0, glm::cos(time) / 3.0f, 0.0f));
+    model = glm::scale(model, glm::vec3(0.1f));
+    model = glm::rotate(model, 5.0f * time, glm::vec3(0.0f, 1.0f, 0.0f));
+    return model;
+}
+
+void renderCube(Shader &shader, glm::vec3 center, float a){
     glm::mat4 model = glm::mat4(1.0f);
 
     model = glm::translate(model, center);
@@ -0,0 +1,162 @@
+// Mip generation benchmark: builds the mip chain of each image with the CPU generator (on one thread and
+// split across the thread pool) and with glGenerateMipmap, and prints the time each takes including the
+// upload. Runs with a hidden window, so it also works on headless software GL (llvmpipe).
+//
+//   mip_benchmark [--srgb] [--runs N] [image...]
+//
+// Without images it measures the textures in resources/textures.
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <stb_image.h>
+
+#include <learnopengl/mip_generator.h>
+#include <learnopengl/stopwatch.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static const char *defaultImages[] = {
+    "resources/textures/bricks2.png",
+    "resources/textures/bricksNormal.png",
+    "resources/textures/brickwall.jpg",
+    "resources/textures/brickwall_normal.jpg",
+    "resources/textures/container.jpg",
+    "resources/textures/mystery.png",
+    "resources/textures/mystery_normal.png",
+};
+
+struct BenchImage {
+    std::string path;
+    unsigned char *pixels = nullptr;
+    int width = 0, height = 0, components = 0;
+};
+
+static GLenum dataFormat(int components)
+{
+    return components == 4 ? GL_RGBA : components == 1 ? GL_RED : GL_RGB;
+}
+
+static GLenum internalFormat(int components, bool srgb)
+{
+    if (components == 4)
+        return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    return components == 1 ? GL_R8 : srgb ? GL_SRGB8 : GL_RGB8;
+}
+
+// uploads the base level and builds the rest with the driver; glFinish so the time covers the GPU work
+static double driverMipmaps(const BenchImage &image, bool srgb)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    Stopwatch timer;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat(image.components, srgb), image.width, image.height, 0,
+                 dataFormat(image.components), GL_UNSIGNED_BYTE, image.pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glFinish();
+    double milliseconds = timer.ElapsedMs();
+    glDeleteTextures(1, &texture);
+    return milliseconds;
+}
+
+// generates the chain on the CPU, on the calling thread or split across pool, and uploads every level
+static double cpuMipmaps(const BenchImage &image, bool srgb, ThreadPool *pool)
+{
+    bool normalMap = MipGenerator::LooksLikeNormalMap(image.path);
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    Stopwatch timer;
+    MipChain mips = MipGenerator::Generate(image.pixels, image.width, image.height, image.components, srgb, normalMap, pool);
+    GLenum format = dataFormat(image.components), internal = internalFormat(image.components, srgb);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, internal, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels);
+    for (unsigned int i = 0; i < mips.levels.size(); i++)
+    {
+        const MipChain::Level &level = mips.levels[i];
+        glTexImage2D(GL_TEXTURE_2D, i + 1, internal, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, &mips.data[level.offset]);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mips.levels.size());
+    glFinish();
+    double milliseconds = timer.ElapsedMs();
+    glDeleteTextures(1, &texture);
+    return milliseconds;
+}
+
+int main(int argc, char **argv)
+{
+    bool srgb = false;
+    int runs = 5;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--srgb")
+            srgb = true;
+        else if (arg == "--runs" && i + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else
+            paths.push_back(arg);
+    }
+    if (paths.empty())
+        paths.assign(std::begin(defaultImages), std::end(defaultImages));
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "mip_benchmark", nullptr, nullptr);
+    if (!window)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return 1;
+    }
+    std::cout << "GL renderer: " << glGetString(GL_RENDERER) << ", " << ThreadPool::Shared().Size()
+              << " pool threads, best of " << runs << " runs" << std::endl;
+
+    double totals[3] = { 0, 0, 0 };
+    for (const std::string &path : paths)
+    {
+        BenchImage image;
+        image.path = path;
+        image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
+        if (!image.pixels)
+        {
+            std::cout << path << ": failed to load" << std::endl;
+            continue;
+        }
+        double best[3] = { 1e30, 1e30, 1e30 };
+        for (int run = 0; run < runs; run++)
+        {
+            best[0] = std::min(best[0], driverMipmaps(image, srgb));
+            best[1] = std::min(best[1], cpuMipmaps(image, srgb, nullptr));
+            best[2] = std::min(best[2], cpuMipmaps(image, srgb, &ThreadPool::Shared()));
+        }
+        std::cout << path << " (" << image.width << "x" << image.height << "x" << image.components << "): glGenerateMipmap "
+                  << best[0] << " ms, CPU " << best[1] << " ms, CPU on the pool " << best[2] << " ms" << std::endl;
+        for (int i = 0; i < 3; i++)
+            totals[i] += best[i];
+        stbi_image_free(image.pixels);
+    }
+    std::cout << "Total: glGenerateMipmap " << totals[0] << " ms, CPU " << totals[1] << " ms, CPU on the pool "
+              << totals[2] << " ms" << std::endl;
+
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,153 @@
+// OBJ import benchmark: reads each file with Assimp and with the ObjLoader fast path, prints the time each
+// takes and checks that both produce the same meshes. Vertices are compared per triangle corner, since
+// Assimp gives every corner its own vertex where ObjLoader shares them. Both get their tangents from
+// TangentSpace, which welds by value, so those must match too. Needs no GL context.
+//
+//   obj_benchmark [--runs N] [model.obj...]
+//
+// Without arguments it measures the OBJ models in resources/objects.
+
+#include <learnopengl/model.h>
+#include <learnopengl/obj_loader.h>
+#include <learnopengl/stopwatch.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static const char *defaultModels[] = {
+    "resources/objects/mario_coin/Mario_Coin.obj",
+    "resources/objects/mario-brick-block/Mario Brick.obj",
+    "resources/objects/blue_shell/Blue Shell.obj",
+    "resources/objects/mario-obj/source/Mario.obj",
+};
+
+static size_t triangleCount(const std::vector<MeshData> &meshes)
+{
+    size_t triangles = 0;
+    for (const MeshData &mesh : meshes)
+        triangles += mesh.indices.size() / 3;
+    return triangles;
+}
+
+static size_t vertexCount(const std::vector<MeshData> &meshes)
+{
+    size_t vertices = 0;
+    for (const MeshData &mesh : meshes)
+        vertices += mesh.vertices.size();
+    return vertices;
+}
+
+static float difference(const glm::vec3 &a, const glm::vec3 &b)
+{
+    glm::vec3 d = glm::abs(a - b);
+    return std::max(d.x, std::max(d.y, d.z));
+}
+
+// largest difference of each attribute over all triangle corners; false if the meshes do not line up
+static bool compare(const std::vector<MeshData> &expected, const std::vector<MeshData> &actual)
+{
+    if (expected.size() != actual.size())
+    {
+        std::cout << "  mesh count differs: Assimp " << expected.size() << ", ObjLoader " << actual.size() << std::endl;
+        return false;
+    }
+    float position = 0.0f, normal = 0.0f, texCoord = 0.0f, tangent = 0.0f;
+    bool same = true;
+    for (size_t m = 0; m < expected.size(); m++)
+    {
+        const MeshData &a = expected[m], &b = actual[m];
+        if (a.indices.size() != b.indices.size())
+        {
+            std::cout << "  mesh " << m << ": " << a.indices.size() / 3 << " triangles with Assimp, "
+                      << b.indices.size() / 3 << " with ObjLoader" << std::endl;
+            same = false;
+            continue;
+        }
+        for (size_t i = 0; i < a.indices.size(); i++)
+        {
+            const Vertex &va = a.vertices[a.indices[i]], &vb = b.vertices[b.indices[i]];
+            position = std::max(position, difference(va.Position, vb.Position));
+            normal = std::max(normal, difference(va.Normal, vb.Normal));
+            texCoord = std::max(texCoord, difference(glm::vec3(va.TexCoords.x, va.TexCoords.y, 0.0f), glm::vec3(vb.TexCoords.x, vb.TexCoords.y, 0.0f)));
+            tangent = std::max(tangent, difference(va.Tangent, vb.Tangent));
+        }
+        if (a.textures.size() != b.textures.size())
+        {
+            std::cout << "  mesh " << m << ": " << a.textures.size() << " textures with Assimp, "
+                      << b.textures.size() << " with ObjLoader" << std::endl;
+            same = false;
+        }
+        for (size_t t = 0; t < std::min(a.textures.size(), b.textures.size()); t++)
+        {
+            if (a.textures[t].type != b.textures[t].type || a.textures[t].path != b.textures[t].path)
+            {
+                std::cout << "  mesh " << m << ": texture " << a.textures[t].type << " " << a.textures[t].path
+                          << " with Assimp, " << b.textures[t].type << " " << b.textures[t].path << " with ObjLoader" << std::endl;
+                same = false;
+            }
+        }
+    }
+    std::cout << "  largest difference per corner: position " << position << ", normal " << normal
+              << ", uv " << texCoord << ", tangent " << tangent << std::endl;
+    return same && position < 1e-5f && normal < 1e-3f && texCoord < 1e-5f && tangent < 1e-2f;
+}
+
+int main(int argc, char **argv)
+{
+    int runs = 3;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--runs" && i + 1 < argc)
+            runs = std::max(1, std::atoi(argv[++i]));
+        else
+            paths.push_back(arg);
+    }
+    if (paths.empty())
+        paths.assign(std::begin(defaultModels), std::end(defaultModels));
+    std::cout << ThreadPool::Shared().Size() << " pool threads, best of " << runs << " runs" << std::endl;
+
+    double totals[2] = { 0, 0 };
+    bool allSame = true;
+    for (const std::string &path : paths)
+    {
+        double best[2] = { 1e30, 1e30 };
+        std::vector<MeshData> assimp, obj;
+        for (int run = 0; run < runs; run++)
+        {
+            assimp.clear();
+            obj.clear();
+            Stopwatch timer;
+            if (!Model::ImportWithAssimp(path, assimp))
+                break;
+            best[0] = std::min(best[0], timer.ElapsedMs());
+            timer.Reset();
+            if (!ObjLoader::Load(path, obj))
+                break;
+            best[1] = std::min(best[1], timer.ElapsedMs());
+        }
+        if (best[0] == 1e30 || best[1] == 1e30)
+        {
+            std::cout << path << ": failed to import" << std::endl;
+            allSame = false;
+            continue;
+        }
+        std::cout << path << ": " << triangleCount(assimp) << " triangles in " << assimp.size() << " meshes; Assimp "
+                  << best[0] << " ms (" << vertexCount(assimp) << " vertices), ObjLoader " << best[1] << " ms ("
+                  << vertexCount(obj) << " vertices), " << best[0] / best[1] << "x" << std::endl;
+        if (!compare(assimp, obj))
+        {
+            std::cout << "  MISMATCH" << std::endl;
+            allSame = false;
+        }
+        totals[0] += best[0];
+        totals[1] += best[1];
+    }
+    std::cout << "Total: Assimp " << totals[0] << " ms, ObjLoader " << totals[1] << " ms" << std::endl;
+    return allSame ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+// Offline texture cooker: compresses PNG/JPG images into block-compressed KTX files with a precomputed
+// mip chain. The game picks up "<name>.ktx" next to "<name>.png" automatically and falls back to the
+// image when there is no cooked file.
+//
+//   texture_cooker [--srgb] [--normal] [--format bc1|bc3|bc4|bc5] <image>...
+//
+// Without --format the format is chosen per image: BC5 for normal maps (--normal, or "normal" in the file
+// name), BC4 for greyscale images, BC3 when the alpha channel is used and BC1 otherwise.
+// --srgb marks colour textures, whose mips are then filtered in linear space.
+
+#include <stb_image.h>
+
+#include <learnopengl/stopwatch.h>
+#include <learnopengl/texture_compress.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace TextureCompression;
+
+struct CookOptions {
+    bool srgb = false;
+    bool normalMap = false;
+    bool forceFormat = false;
+    Format format = BC1;
+};
+
+static bool parseFormat(std::string name, Format &format)
+{
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    const char *names[4] = { "bc1", "bc3", "bc4", "bc5" };
+    const Format formats[4] = { BC1, BC3, BC4, BC5 };
+    for (int i = 0; i < 4; i++)
+    {
+        if (name == names[i])
+        {
+            format = formats[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static Format chooseFormat(const std::vector<unsigned char> &rgba, int components, bool normalMap)
+{
+    if (normalMap)
+        return BC5;
+    bool grey = components <= 2, opaque = components != 2 && components != 4;
+    if (!grey || !opaque)
+    {
+        grey = true;
+        opaque = true;
+        for (size_t i = 0; i < rgba.size(); i += 4)
+        {
+            grey = grey && rgba[i] == rgba[i + 1] && rgba[i] == rgba[i + 2];
+            opaque = opaque && rgba[i + 3] == 255;
+        }
+    }
+    if (!opaque)
+        return BC3;
+    return grey ? BC4 : BC1;
+}
+
+// peak signal-to-noise ratio of the top level against the source, decoded with the reference block formulas
+static double levelPSNR(Format format, const CompressedTexture &texture, const std::vector<unsigned char> &rgba)
+{
+    const CompressedTexture::Level &level = texture.levels[0];
+    int blocksX = (level.width + 3) / 4;
+    double squaredError = 0.0;
+    size_t samples = 0;
+    for (int y = 0; y < level.height; y++)
+    {
+        for (int x = 0; x < level.width; x++)
+        {
+            const unsigned char *block = &texture.data[((y / 4) * blocksX + x / 4) * BlockBytes(format)];
+            int texel = (y % 4) * 4 + x % 4;
+            const unsigned char *source = &rgba[4 * ((size_t)y * level.width + x)];
+            float decoded[4];
+            int channels = 0;
+            auto decodeBC4 = [texel](const unsigned char *b) {
+                uint64_t bits = 0;
+                for (int i = 0; i < 6; i++)
+                    bits |= (uint64_t)b[2 + i] << (8 * i);
+                int index = (bits >> (3 * texel)) & 7;
+                float r0 = b[0], r1 = b[1];
+                if (index == 0) return r0;
+                if (index == 1) return r1;
+                return r0 > r1 ? ((8 - index) * r0 + (index - 1) * r1) / 7.0f
+                               : (index == 6 ? 0.0f : index == 7 ? 255.0f : ((6 - index) * r0 + (index - 1) * r1) / 5.0f);
+            };
+            auto decodeBC1 = [texel, &decoded](const unsigned char *b) {
+                uint16_t c0 = b[0] | (b[1] << 8), c1 = b[2] | (b[3] << 8);
+                float p0[3], p1[3];
+                unpackRGB565(c0, p0);
+                unpackRGB565(c1, p1);
+                int index = (b[4 + texel / 4] >> (2 * (texel % 4))) & 3;
+                for (int k = 0; k < 3; k++)
+                {
+                    const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+                    decoded[k] = p0[k] * weights[index] + p1[k] * (1.0f - weights[index]);
+                }
+            };
+            switch (format)
+            {
+                case BC1: decodeBC1(block); channels = 3; break;
+                case BC3: decodeBC1(block + 8); decoded[3] = decodeBC4(block); channels = 4; break;
+                case BC4: decoded[0] = decodeBC4(block); channels = 1; break;
+                case BC5: decoded[0] = decodeBC4(block); decoded[1] = decodeBC4(block + 8); channels = 2; break;
+            }
+            for (int k = 0; k < channels; k++)
+            {
+                int c = format == BC3 && k == 3 ? 3 : k;
+                double diff = decoded[k] - source[c];
+                squaredError += diff * diff;
+                samples++;
+            }
+        }
+    }
+    double mse = squaredError / std::max<size_t>(samples, 1);
+    return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
+
+static bool cook(const std::string &path, const CookOptions &options)
+{
+    int width, height, components;
+    unsigned char *pixels = stbi_load(path.c_str(), &width, &height, &components, 4);
+    if (!pixels)
+    {
+        std::cout << path << ": failed to load (" << stbi_failure_reason() << ")" << std::endl;
+        return false;
+    }
+    std::vector<unsigned char> rgba(pixels, pixels + (size_t)width * height * 4);
+    stbi_image_free(pixels);
+
+    std::string lowerPath = path;
+    std::transform(lowerPath.begin(), lowerPath.end(), lowerPath.begin(), ::tolower);
+    bool normalMap = options.normalMap || (!options.forceFormat && lowerPath.find("normal") != std::string::npos);
+    Format format = options.forceFormat ? options.format : chooseFormat(rgba, components, normalMap);
+    // a grey colour texture still has to be readable as sRGB
+    if (!options.forceFormat && options.srgb && format == BC4)
+        format = BC1;
+    normalMap = normalMap && format == BC5;
+    // BC4/BC5 have no sRGB variants, their channels are always data
+    bool srgb = options.srgb && (format == BC1 || format == BC3);
+
+    Stopwatch timer;
+    CompressedTexture texture = Compress(format, rgba, width, height, srgb, normalMap);
+    double milliseconds = timer.ElapsedMs();
+
+    std::string outPath = CookedPath(path);
+    if (!WriteKTX(outPath, texture))
+    {
+        std::cout << outPath << ": failed to write" << std::endl;
+        return false;
+    }
+    size_t uncompressed = (size_t)width * height * components * 4 / 3;
+    std::cout << outPath << ": " << width << "x" << height << " " << FormatName(texture.internalFormat)
+              << (srgb ? " sRGB" : "") << ", " << texture.levels.size() << " levels, "
+              << texture.ByteSize() / 1024 << " KiB (uncompressed with mips " << uncompressed / 1024 << " KiB), "
+              << "PSNR " << levelPSNR(format, texture, rgba) << " dB, " << milliseconds << " ms" << std::endl;
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    CookOptions options;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--srgb")
+            options.srgb = true;
+        else if (arg == "--normal")
+            options.normalMap = true;
+        else if (arg == "--format" && i + 1 < argc && parseFormat(argv[i + 1], options.format))
+        {
+            options.forceFormat = true;
+            i++;
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            std::cout << "unknown option " << arg << std::endl;
+            return 1;
+        }
+        else
+            paths.push_back(arg);
+    }
+    if (paths.empty())
+    {
+        std::cout << "usage: texture_cooker [--srgb] [--normal] [--format bc1|bc3|bc4|bc5] <image>..." << std::endl;
+        return 1;
+    }
+
+    int failures = 0;
+    for (const std::string &path : paths)
+        if (!cook(path, options))
+            failures++;
+    return failures ? 1 : 0;
+}